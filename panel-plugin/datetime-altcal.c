@@ -0,0 +1,481 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+/* local includes */
+#include <time.h>
+#include <string.h>
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "datetime-altcal.h"
+
+/*
+ * The tables hold the first day of every year which overlaps the Gregorian
+ * years 1800 to 2200, in days since 1970-01-01, so that converting a date
+ * is a lookup plus arithmetic. They were computed from Borkowski's rules
+ * for the Persian calendar, which follow the vernal equinox in Tehran in
+ * this range, the rules of the fixed Hebrew calendar, and the tabular
+ * Islamic calendar with the civil epoch, which can be a day off the
+ * sighted or Umm al-Qura months.
+ */
+/* first day of the years 1178 to 1579, and of the year after */
+static const gint32 altcal_persian_years[] = {
+  -62377, -62012, -61647, -61282, -60916, -60551, -60186, -59821,
+  -59455, -59090, -58725, -58360, -57994, -57629, -57264, -56899,
+  -56533, -56168, -55803, -55438, -55072, -54707, -54342, -53977,
+  -53611, -53246, -52881, -52516, -52150, -51785, -51420, -51055,
+  -50690, -50324, -49959, -49594, -49229, -48863, -48498, -48133,
+  -47768, -47402, -47037, -46672, -46307, -45941, -45576, -45211,
+  -44846, -44480, -44115, -43750, -43385, -43019, -42654, -42289,
+  -41924, -41558, -41193, -40828, -40463, -40097, -39732, -39367,
+  -39002, -38637, -38271, -37906, -37541, -37176, -36810, -36445,
+  -36080, -35715, -35349, -34984, -34619, -34254, -33888, -33523,
+  -33158, -32793, -32427, -32062, -31697, -31332, -30966, -30601,
+  -30236, -29871, -29505, -29140, -28775, -28410, -28044, -27679,
+  -27314, -26949, -26584, -26218, -25853, -25488, -25123, -24757,
+  -24392, -24027, -23662, -23296, -22931, -22566, -22201, -21835,
+  -21470, -21105, -20740, -20374, -20009, -19644, -19279, -18913,
+  -18548, -18183, -17818, -17452, -17087, -16722, -16357, -15991,
+  -15626, -15261, -14896, -14531, -14165, -13800, -13435, -13070,
+  -12704, -12339, -11974, -11609, -11243, -10878, -10513, -10148,
+  -9782, -9417, -9052, -8687, -8321, -7956, -7591, -7226,
+  -6860, -6495, -6130, -5765, -5399, -5034, -4669, -4304,
+  -3938, -3573, -3208, -2843, -2478, -2112, -1747, -1382,
+  -1017, -651, -286, 79, 444, 810, 1175, 1540,
+  1905, 2271, 2636, 3001, 3366, 3732, 4097, 4462,
+  4827, 5193, 5558, 5923, 6288, 6654, 7019, 7384,
+  7749, 8115, 8480, 8845, 9210, 9575, 9941, 10306,
+  10671, 11036, 11402, 11767, 12132, 12497, 12863, 13228,
+  13593, 13958, 14324, 14689, 15054, 15419, 15785, 16150,
+  16515, 16880, 17246, 17611, 17976, 18341, 18707, 19072,
+  19437, 19802, 20168, 20533, 20898, 21263, 21628, 21994,
+  22359, 22724, 23089, 23455, 23820, 24185, 24550, 24916,
+  25281, 25646, 26011, 26377, 26742, 27107, 27472, 27838,
+  28203, 28568, 28933, 29299, 29664, 30029, 30394, 30760,
+  31125, 31490, 31855, 32221, 32586, 32951, 33316, 33681,
+  34047, 34412, 34777, 35142, 35508, 35873, 36238, 36603,
+  36969, 37334, 37699, 38064, 38430, 38795, 39160, 39525,
+  39891, 40256, 40621, 40986, 41352, 41717, 42082, 42447,
+  42813, 43178, 43543, 43908, 44274, 44639, 45004, 45369,
+  45734, 46100, 46465, 46830, 47195, 47561, 47926, 48291,
+  48656, 49022, 49387, 49752, 50117, 50483, 50848, 51213,
+  51578, 51944, 52309, 52674, 53039, 53405, 53770, 54135,
+  54500, 54866, 55231, 55596, 55961, 56327, 56692, 57057,
+  57422, 57787, 58153, 58518, 58883, 59248, 59614, 59979,
+  60344, 60709, 61075, 61440, 61805, 62170, 62536, 62901,
+  63266, 63631, 63997, 64362, 64727, 65092, 65458, 65823,
+  66188, 66553, 66919, 67284, 67649, 68014, 68380, 68745,
+  69110, 69475, 69840, 70206, 70571, 70936, 71301, 71667,
+  72032, 72397, 72762, 73128, 73493, 73858, 74223, 74589,
+  74954, 75319, 75684, 76050, 76415, 76780, 77145, 77511,
+  77876, 78241, 78606, 78972, 79337, 79702, 80067, 80433,
+  80798, 81163, 81528, 81893, 82259, 82624, 82989, 83354,
+  83720, 84085, 84450
+};
+
+/* first day of the years 5560 to 5961, and of the year after */
+static const gint32 altcal_hebrew_years[] = {
+  -62184, -61829, -61476, -61092, -60737, -60382, -59999, -59645,
+  -59260, -58905, -58551, -58168, -57813, -57459, -57076, -56721,
+  -56336, -55982, -55629, -55244, -54890, -54535, -54152, -53798,
+  -53443, -53060, -52705, -52321, -51966, -51613, -51229, -50874,
+  -50519, -50136, -49782, -49397, -49042, -48688, -48305, -47950,
+  -47596, -47211, -46858, -46504, -46119, -45764, -45381, -45027,
+  -44672, -44289, -43935, -43580, -43195, -42842, -42458, -42103,
+  -41748, -41365, -41011, -40656, -40271, -39917, -39564, -39179,
+  -38825, -38442, -38087, -37733, -37348, -36995, -36641, -36256,
+  -35901, -35518, -35164, -34809, -34426, -34071, -33717, -33332,
+  -32977, -32623, -32240, -31885, -31502, -31148, -30793, -30408,
+  -30054, -29701, -29316, -28962, -28579, -28224, -27870, -27485,
+  -27132, -26777, -26393, -26038, -25685, -25301, -24946, -24563,
+  -24208, -23854, -23469, -23114, -22760, -22377, -22022, -21639,
+  -21285, -20930, -20545, -20191, -19838, -19453, -19099, -18744,
+  -18361, -18007, -17622, -17267, -16914, -16530, -16175, -15820,
+  -15437, -15083, -14698, -14345, -13991, -13606, -13251, -12897,
+  -12514, -12159, -11805, -11420, -11067, -10682, -10328, -9973,
+  -9590, -9236, -8881, -8498, -8144, -7759, -7404, -7051,
+  -6667, -6312, -5957, -5574, -5220, -4865, -4480, -4126,
+  -3743, -3388, -3034, -2651, -2296, -1942, -1557, -1204,
+  -819, -465, -110, 273, 627, 982, 1365, 1720,
+  2074, 2459, 2812, 3196, 3551, 3906, 4289, 4643,
+  4998, 5383, 5737, 6120, 6475, 6829, 7212, 7567,
+  7921, 8306, 8659, 9014, 9398, 9753, 10136, 10490,
+  10845, 11230, 11583, 11937, 12322, 12677, 13060, 13414,
+  13769, 14152, 14506, 14861, 15246, 15600, 15953, 16338,
+  16692, 17077, 17430, 17784, 18169, 18524, 18877, 19261,
+  19616, 19999, 20354, 20708, 21093, 21448, 21802, 22185,
+  22540, 22894, 23277, 23632, 24017, 24371, 24724, 25109,
+  25463, 25818, 26201, 26555, 26940, 27293, 27648, 28032,
+  28387, 28740, 29124, 29479, 29834, 30217, 30571, 30956,
+  31311, 31665, 32048, 32403, 32757, 33140, 33495, 33880,
+  34234, 34587, 34972, 35326, 35681, 36064, 36418, 36773,
+  37156, 37511, 37895, 38250, 38603, 38987, 39342, 39697,
+  40080, 40434, 40819, 41174, 41528, 41911, 42266, 42620,
+  43003, 43358, 43712, 44097, 44450, 44835, 45189, 45544,
+  45927, 46281, 46636, 47021, 47374, 47758, 48113, 48468,
+  48851, 49205, 49560, 49945, 50299, 50652, 51037, 51391,
+  51774, 52129, 52483, 52868, 53221, 53575, 53960, 54315,
+  54698, 55052, 55407, 55790, 56145, 56499, 56884, 57239,
+  57593, 57976, 58331, 58714, 59068, 59423, 59808, 60162,
+  60515, 60900, 61254, 61637, 61992, 62346, 62731, 63084,
+  63439, 63823, 64178, 64531, 64915, 65270, 65653, 66008,
+  66362, 66747, 67102, 67456, 67839, 68194, 68577, 68931,
+  69286, 69671, 70025, 70378, 70763, 71117, 71472, 71855,
+  72209, 72594, 72947, 73302, 73686, 74041, 74394, 74778,
+  75133, 75518, 75871, 76225, 76610, 76965, 77319, 77702,
+  78057, 78411, 78796, 79149, 79534, 79888, 80243, 80626,
+  80980, 81335, 81718, 82072, 82457, 82812, 83165, 83549,
+  83904, 84259, 84642
+};
+
+/* first day of the years 1214 to 1627, and of the year after */
+static const gint32 altcal_hijri_years[] = {
+  -62301, -61947, -61593, -61238, -60884, -60529, -60175, -59821,
+  -59466, -59112, -58758, -58403, -58049, -57694, -57340, -56986,
+  -56631, -56277, -55923, -55568, -55214, -54860, -54505, -54151,
+  -53796, -53442, -53088, -52733, -52379, -52025, -51670, -51316,
+  -50962, -50607, -50253, -49898, -49544, -49190, -48835, -48481,
+  -48127, -47772, -47418, -47063, -46709, -46355, -46000, -45646,
+  -45292, -44937, -44583, -44229, -43874, -43520, -43165, -42811,
+  -42457, -42102, -41748, -41394, -41039, -40685, -40331, -39976,
+  -39622, -39267, -38913, -38559, -38204, -37850, -37496, -37141,
+  -36787, -36432, -36078, -35724, -35369, -35015, -34661, -34306,
+  -33952, -33598, -33243, -32889, -32534, -32180, -31826, -31471,
+  -31117, -30763, -30408, -30054, -29700, -29345, -28991, -28636,
+  -28282, -27928, -27573, -27219, -26865, -26510, -26156, -25801,
+  -25447, -25093, -24738, -24384, -24030, -23675, -23321, -22967,
+  -22612, -22258, -21903, -21549, -21195, -20840, -20486, -20132,
+  -19777, -19423, -19069, -18714, -18360, -18005, -17651, -17297,
+  -16942, -16588, -16234, -15879, -15525, -15170, -14816, -14462,
+  -14107, -13753, -13399, -13044, -12690, -12336, -11981, -11627,
+  -11272, -10918, -10564, -10209, -9855, -9501, -9146, -8792,
+  -8438, -8083, -7729, -7374, -7020, -6666, -6311, -5957,
+  -5603, -5248, -4894, -4539, -4185, -3831, -3476, -3122,
+  -2768, -2413, -2059, -1705, -1350, -996, -641, -287,
+  67, 422, 776, 1130, 1485, 1839, 2193, 2548,
+  2902, 3257, 3611, 3965, 4320, 4674, 5028, 5383,
+  5737, 6092, 6446, 6800, 7155, 7509, 7863, 8218,
+  8572, 8926, 9281, 9635, 9990, 10344, 10698, 11053,
+  11407, 11761, 12116, 12470, 12824, 13179, 13533, 13888,
+  14242, 14596, 14951, 15305, 15659, 16014, 16368, 16723,
+  17077, 17431, 17786, 18140, 18494, 18849, 19203, 19557,
+  19912, 20266, 20621, 20975, 21329, 21684, 22038, 22392,
+  22747, 23101, 23455, 23810, 24164, 24519, 24873, 25227,
+  25582, 25936, 26290, 26645, 26999, 27354, 27708, 28062,
+  28417, 28771, 29125, 29480, 29834, 30188, 30543, 30897,
+  31252, 31606, 31960, 32315, 32669, 33023, 33378, 33732,
+  34086, 34441, 34795, 35150, 35504, 35858, 36213, 36567,
+  36921, 37276, 37630, 37985, 38339, 38693, 39048, 39402,
+  39756, 40111, 40465, 40819, 41174, 41528, 41883, 42237,
+  42591, 42946, 43300, 43654, 44009, 44363, 44717, 45072,
+  45426, 45781, 46135, 46489, 46844, 47198, 47552, 47907,
+  48261, 48616, 48970, 49324, 49679, 50033, 50387, 50742,
+  51096, 51450, 51805, 52159, 52514, 52868, 53222, 53577,
+  53931, 54285, 54640, 54994, 55348, 55703, 56057, 56412,
+  56766, 57120, 57475, 57829, 58183, 58538, 58892, 59247,
+  59601, 59955, 60310, 60664, 61018, 61373, 61727, 62081,
+  62436, 62790, 63145, 63499, 63853, 64208, 64562, 64916,
+  65271, 65625, 65979, 66334, 66688, 67043, 67397, 67751,
+  68106, 68460, 68814, 69169, 69523, 69878, 70232, 70586,
+  70941, 71295, 71649, 72004, 72358, 72712, 73067, 73421,
+  73776, 74130, 74484, 74839, 75193, 75547, 75902, 76256,
+  76610, 76965, 77319, 77674, 78028, 78382, 78737, 79091,
+  79445, 79800, 80154, 80509, 80863, 81217, 81572, 81926,
+  82280, 82635, 82989, 83343, 83698, 84052, 84407
+};
+
+/* bit n is set if month n + 1 of the year has 30 days */
+static const guint16 altcal_hijri_months[] = {
+  0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555,
+  0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555,
+  0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555,
+  0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555,
+  0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555,
+  0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555,
+  0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555,
+  0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555,
+  0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555,
+  0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555,
+  0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555,
+  0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555,
+  0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555,
+  0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555,
+  0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555,
+  0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555,
+  0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555,
+  0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555,
+  0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55,
+  0x555, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0xd55, 0x555, 0x555, 0xd55, 0x555, 0x555,
+  0xd55, 0x555, 0x555, 0xd55, 0x555, 0xd55
+};
+
+
+static const gchar *altcal_names[ALTCAL_COUNT] = {
+  "persian",
+  "hebrew",
+  "hijri"
+};
+
+static const gchar *altcal_persian_month_names[] = {
+  N_("Farvardin"), N_("Ordibehesht"), N_("Khordad"), N_("Tir"),
+  N_("Mordad"), N_("Shahrivar"), N_("Mehr"), N_("Aban"),
+  N_("Azar"), N_("Dey"), N_("Bahman"), N_("Esfand")
+};
+
+/* in the order of a leap year, then Adar of common years */
+static const gchar *altcal_hebrew_month_names[] = {
+  N_("Tishrei"), N_("Cheshvan"), N_("Kislev"), N_("Tevet"),
+  N_("Shevat"), N_("Adar I"), N_("Adar II"), N_("Nisan"),
+  N_("Iyar"), N_("Sivan"), N_("Tammuz"), N_("Av"),
+  N_("Elul"), N_("Adar")
+};
+
+static const gchar *altcal_hijri_month_names[] = {
+  N_("Muharram"), N_("Safar"), N_("Rabi al-Awwal"), N_("Rabi al-Thani"),
+  N_("Jumada al-Ula"), N_("Jumada al-Akhirah"), N_("Rajab"), N_("Shaban"),
+  N_("Ramadan"), N_("Shawwal"), N_("Dhu al-Qadah"), N_("Dhu al-Hijjah")
+};
+
+typedef struct {
+  const gint32 *years;
+  guint n_years;          /* the table holds one more start than years */
+  gint first_year;
+  gint mean_year;         /* mean length of a year in 1/10000 days */
+} t_altcal_table;
+
+static const t_altcal_table altcal_tables[ALTCAL_COUNT] = {
+  { altcal_persian_years, G_N_ELEMENTS(altcal_persian_years) - 1, 1178, 3652422 },
+  { altcal_hebrew_years, G_N_ELEMENTS(altcal_hebrew_years) - 1, 5560, 3652468 },
+  { altcal_hijri_years, G_N_ELEMENTS(altcal_hijri_years) - 1, 1214, 3543667 }
+};
+
+/* the date of each calendar on the day it was last converted */
+typedef struct {
+  gint32 day;
+  gboolean valid;
+  t_altcal_date date;
+} t_altcal_cache;
+
+static t_altcal_cache altcal_cache[ALTCAL_COUNT];
+G_LOCK_DEFINE_STATIC(altcal_cache);
+
+/*
+ * Find a calendar by the name in a format.
+ * Returns -1 if there is no such calendar.
+ */
+gint datetime_altcal_lookup(const gchar *name, gsize len)
+{
+  guint i;
+
+  for (i = 0; i < ALTCAL_COUNT; i++)
+    if (strlen(altcal_names[i]) == len && strncmp(altcal_names[i], name, len) == 0)
+      return i;
+
+  return -1;
+}
+
+/*
+ * Days since 1970-01-01 of a Gregorian date.
+ */
+static gint32 datetime_altcal_days(gint year, guint month, guint day)
+{
+  gint era;
+  guint yoe, doy, doe;
+
+  year -= month <= 2;
+  era = (year >= 0 ? year : year - 399) / 400;
+  yoe = (guint) (year - era * 400);
+  doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+  return era * 146097 + (gint32) doe - 719468;
+}
+
+/*
+ * Split the day of a year into its month and day.
+ */
+static void datetime_altcal_split(t_altcal calendar,
+                                  guint year_index,
+                                  gint length,
+                                  t_altcal_date *date)
+{
+  gint months[13];
+  gint n_months = 12;
+  gint yday = date->yday;
+  gint i;
+
+  switch (calendar)
+  {
+    case ALTCAL_PERSIAN:
+      /* six months of 31 days, five of 30, and the last of 29 or 30 */
+      date->leap = (length == 366);
+      if (yday < 6 * 31)
+      {
+        date->month = yday / 31 + 1;
+        date->day = yday % 31 + 1;
+      }
+      else
+      {
+        date->month = (yday - 6 * 31) / 30 + 7;
+        date->day = (yday - 6 * 31) % 30 + 1;
+      }
+      return;
+
+    case ALTCAL_HEBREW:
+      /* years of 353 to 355 days, or 383 to 385 with a leap month */
+      date->leap = (length > 355);
+      months[0] = 30;
+      months[1] = (length % 10 == 5) ? 30 : 29;
+      months[2] = (length % 10 == 3) ? 29 : 30;
+      months[3] = 29;
+      months[4] = 30;
+      n_months = 5;
+      if (date->leap)
+        months[n_months++] = 30;
+      for (i = 0; i < 7; i++)
+        months[n_months++] = (i % 2 == 0) ? 29 : 30;
+      break;
+
+    case ALTCAL_HIJRI:
+      date->leap = (length == 355);
+      for (i = 0; i < 12; i++)
+        months[i] = (altcal_hijri_months[year_index] & (1 << i)) ? 30 : 29;
+      break;
+
+    default:
+      g_assert_not_reached();
+  }
+
+  for (i = 0; i < n_months - 1 && yday >= months[i]; i++)
+    yday -= months[i];
+  date->month = i + 1;
+  date->day = yday + 1;
+}
+
+/*
+ * Convert the date of tm into a calendar.
+ * The date only changes at midnight, so the last one is kept per calendar.
+ * Returns FALSE if the date is outside of the tables.
+ */
+gboolean datetime_altcal_convert(t_altcal calendar,
+                                 const struct tm *tm,
+                                 t_altcal_date *date)
+{
+  const t_altcal_table *table = &altcal_tables[calendar];
+  t_altcal_cache *cache = &altcal_cache[calendar];
+  gint32 day;
+  gint index;
+
+  day = datetime_altcal_days(tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
+
+  G_LOCK(altcal_cache);
+  if (cache->valid && cache->day == day)
+  {
+    *date = cache->date;
+    G_UNLOCK(altcal_cache);
+    return TRUE;
+  }
+  G_UNLOCK(altcal_cache);
+
+  if (day < table->years[0] || day >= table->years[table->n_years])
+    return FALSE;
+
+  /* estimated from the mean length of a year, which is off by one at most */
+  index = (gint) (((gint64) day - table->years[0]) * 10000 / table->mean_year);
+  index = CLAMP(index, 0, (gint) table->n_years - 1);
+  while (index > 0 && table->years[index] > day)
+    index--;
+  while (index < (gint) table->n_years - 1 && table->years[index + 1] <= day)
+    index++;
+
+  date->year = table->first_year + index;
+  date->yday = day - table->years[index];
+  datetime_altcal_split(calendar, index,
+                        table->years[index + 1] - table->years[index], date);
+
+  G_LOCK(altcal_cache);
+  cache->day = day;
+  cache->date = *date;
+  cache->valid = TRUE;
+  G_UNLOCK(altcal_cache);
+
+  return TRUE;
+}
+
+/*
+ * Translated name of the month of a date.
+ */
+const gchar * datetime_altcal_month_name(t_altcal calendar,
+                                         const t_altcal_date *date)
+{
+  switch (calendar)
+  {
+    case ALTCAL_PERSIAN:
+      return _(altcal_persian_month_names[date->month - 1]);
+
+    case ALTCAL_HEBREW:
+      if (date->leap || date->month < 6)
+        return _(altcal_hebrew_month_names[date->month - 1]);
+      if (date->month == 6)
+        return _(altcal_hebrew_month_names[13]);
+      return _(altcal_hebrew_month_names[date->month]);
+
+    case ALTCAL_HIJRI:
+      return _(altcal_hijri_month_names[date->month - 1]);
+
+    default:
+      return "";
+  }
+}
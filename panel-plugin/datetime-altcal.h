@@ -0,0 +1,56 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _DATETIME_ALTCAL_H
+#define _DATETIME_ALTCAL_H	1
+
+#include <time.h>
+#include <glib.h>
+
+/* calendars shown with %(name)X conversions, e.g. %(persian)d */
+typedef enum
+{
+  ALTCAL_PERSIAN = 0,
+  ALTCAL_HEBREW,
+  ALTCAL_HIJRI,
+  ALTCAL_COUNT
+} t_altcal;
+
+/* a date in one of the calendars */
+typedef struct {
+  gint year;
+  gint month;   /* 1 to 12, or 13 in Hebrew leap years */
+  gint day;     /* 1 to 31 */
+  gint yday;    /* days since the first day of the year, 0 to 384 */
+  gboolean leap;
+} t_altcal_date;
+
+gint
+datetime_altcal_lookup(const gchar *name,
+    gsize len);
+
+gboolean
+datetime_altcal_convert(t_altcal calendar,
+    const struct tm *tm,
+    t_altcal_date *date);
+
+const gchar *
+datetime_altcal_month_name(t_altcal calendar,
+    const t_altcal_date *date);
+
+#endif /* datetime-altcal.h */
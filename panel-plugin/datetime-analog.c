@@ -0,0 +1,303 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+/* local includes */
+#include <time.h>
+#include <math.h>
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "datetime-analog.h"
+
+/* smallest dial in pixels with minute ticks, and with numerals */
+#define ANALOG_MINUTE_TICKS_SIZE 32
+#define ANALOG_NUMERALS_SIZE 64
+
+enum {
+  ANALOG_HOUR = 0,
+  ANALOG_MINUTE,
+  ANALOG_SECOND,
+  ANALOG_HANDS
+};
+
+typedef struct {
+  gdouble length;     /* fraction of the radius */
+  gdouble width;      /* fraction of the radius, at least a pixel */
+  gdouble angle;      /* clockwise from twelve o'clock, in radians */
+  gboolean visible;
+  GdkRectangle area;  /* covered by the hand when it was last invalidated */
+} t_analog_hand;
+
+struct _t_analog_face {
+  cairo_surface_t *dial;  /* everything but the hands */
+  gint size;              /* of the dial in pixels */
+  gint scale;
+  GdkRGBA color;
+  gint width;             /* allocation the hand areas were computed for */
+  gint height;
+  t_analog_hand hands[ANALOG_HANDS];
+};
+
+t_analog_face * datetime_analog_face_new(void)
+{
+  t_analog_face *face = g_slice_new0(t_analog_face);
+
+  face->hands[ANALOG_HOUR].length = 0.5;
+  face->hands[ANALOG_HOUR].width = 0.1;
+  face->hands[ANALOG_MINUTE].length = 0.78;
+  face->hands[ANALOG_MINUTE].width = 0.06;
+  face->hands[ANALOG_SECOND].length = 0.85;
+  face->hands[ANALOG_SECOND].width = 0.02;
+
+  return face;
+}
+
+void datetime_analog_face_free(t_analog_face *face)
+{
+  if (face->dial != NULL)
+    cairo_surface_destroy(face->dial);
+  g_slice_free(t_analog_face, face);
+}
+
+/*
+ * Drop the cached dial, e.g. when the font of the numerals changed.
+ */
+void datetime_analog_face_flush(t_analog_face *face)
+{
+  if (face->dial != NULL)
+    cairo_surface_destroy(face->dial);
+  face->dial = NULL;
+}
+
+/*
+ * Center and radius of the face, which is as big as fits the widget.
+ */
+static void datetime_analog_geometry(GtkWidget *widget,
+                                     gdouble *cx,
+                                     gdouble *cy,
+                                     gdouble *radius)
+{
+  gint width = gtk_widget_get_allocated_width(widget);
+  gint height = gtk_widget_get_allocated_height(widget);
+
+  *cx = width / 2.0;
+  *cy = height / 2.0;
+  *radius = MIN(width, height) / 2.0;
+}
+
+static gdouble datetime_analog_hand_width(const t_analog_hand *hand,
+                                          gdouble radius)
+{
+  return MAX(hand->width * radius, 1.0);
+}
+
+/*
+ * Area covered by a hand, including its round caps.
+ */
+static void datetime_analog_hand_area(const t_analog_hand *hand,
+                                      GtkWidget *widget,
+                                      GdkRectangle *area)
+{
+  gdouble cx, cy, radius, x, y, margin;
+
+  datetime_analog_geometry(widget, &cx, &cy, &radius);
+  x = cx + sin(hand->angle) * hand->length * radius;
+  y = cy - cos(hand->angle) * hand->length * radius;
+  margin = datetime_analog_hand_width(hand, radius) / 2 + 1;
+
+  area->x = floor(MIN(cx, x) - margin);
+  area->y = floor(MIN(cy, y) - margin);
+  area->width = ceil(MAX(cx, x) + margin) - area->x;
+  area->height = ceil(MAX(cy, y) + margin) - area->y;
+}
+
+/*
+ * Move the hands to the given time, and invalidate only the areas of the
+ * hands which moved: where they were, and where they are now.
+ */
+void datetime_analog_face_set_time(t_analog_face *face,
+                                   GtkWidget *widget,
+                                   const struct tm *tm,
+                                   gboolean seconds)
+{
+  gdouble angles[ANALOG_HANDS];
+  t_analog_hand *hand;
+  gint width = gtk_widget_get_allocated_width(widget);
+  gint height = gtk_widget_get_allocated_height(widget);
+  gboolean resized = (width != face->width || height != face->height);
+  gboolean visible;
+  guint i;
+
+  /* the areas of the hands moved with the center of a resized face */
+  if (resized)
+  {
+    face->width = width;
+    face->height = height;
+    gtk_widget_queue_draw(widget);
+  }
+
+  angles[ANALOG_HOUR] = (tm->tm_hour % 12 + tm->tm_min / 60.0) * G_PI / 6;
+  angles[ANALOG_MINUTE] = tm->tm_min * G_PI / 30;
+  angles[ANALOG_SECOND] = tm->tm_sec * G_PI / 30;
+
+  for (i = 0; i < ANALOG_HANDS; i++)
+  {
+    hand = &face->hands[i];
+    visible = (i != ANALOG_SECOND || seconds);
+    if (!resized && visible == hand->visible &&
+        (!visible || angles[i] == hand->angle))
+      continue;
+
+    if (hand->visible && !resized)
+      gtk_widget_queue_draw_area(widget, hand->area.x, hand->area.y,
+                                 hand->area.width, hand->area.height);
+
+    hand->angle = angles[i];
+    hand->visible = visible;
+    if (visible)
+    {
+      datetime_analog_hand_area(hand, widget, &hand->area);
+      if (!resized)
+        gtk_widget_queue_draw_area(widget, hand->area.x, hand->area.y,
+                                   hand->area.width, hand->area.height);
+    }
+  }
+}
+
+/*
+ * Draw the ring, the ticks and, if there is room, the numerals.
+ */
+static void datetime_analog_dial_new(t_analog_face *face, GtkWidget *widget)
+{
+  PangoLayout *layout;
+  PangoFontDescription *desc;
+  PangoRectangle logical;
+  gdouble radius = face->size / 2.0;
+  gdouble inner, x, y;
+  gchar numeral[3];
+  cairo_t *cr;
+  gint i;
+
+  face->dial = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                          MAX(face->size, 1) * face->scale,
+                                          MAX(face->size, 1) * face->scale);
+  cairo_surface_set_device_scale(face->dial, face->scale, face->scale);
+
+  cr = cairo_create(face->dial);
+  gdk_cairo_set_source_rgba(cr, &face->color);
+  cairo_translate(cr, radius, radius);
+  cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+
+  cairo_set_line_width(cr, MAX(radius / 20, 1.0));
+  cairo_arc(cr, 0, 0, radius - cairo_get_line_width(cr) / 2, 0, 2 * G_PI);
+  cairo_stroke(cr);
+
+  for (i = 0; i < 60; i++)
+  {
+    if (i % 5 != 0 && face->size < ANALOG_MINUTE_TICKS_SIZE)
+      continue;
+
+    inner = radius * (i % 5 == 0 ? 0.82 : 0.9);
+    cairo_set_line_width(cr, MAX(radius * (i % 5 == 0 ? 0.05 : 0.02), 1.0));
+    cairo_move_to(cr, sin(i * G_PI / 30) * inner, -cos(i * G_PI / 30) * inner);
+    cairo_line_to(cr, sin(i * G_PI / 30) * radius * 0.95,
+                  -cos(i * G_PI / 30) * radius * 0.95);
+    cairo_stroke(cr);
+  }
+
+  if (face->size >= ANALOG_NUMERALS_SIZE)
+  {
+    layout = gtk_widget_create_pango_layout(widget, NULL);
+    desc = pango_font_description_copy(
+        pango_context_get_font_description(gtk_widget_get_pango_context(widget)));
+    pango_font_description_set_absolute_size(desc, radius * 0.2 * PANGO_SCALE);
+    pango_layout_set_font_description(layout, desc);
+
+    for (i = 1; i <= 12; i++)
+    {
+      g_snprintf(numeral, sizeof(numeral), "%d", i);
+      pango_layout_set_text(layout, numeral, -1);
+      pango_layout_get_pixel_extents(layout, NULL, &logical);
+      x = sin(i * G_PI / 6) * radius * 0.66;
+      y = -cos(i * G_PI / 6) * radius * 0.66;
+      cairo_move_to(cr, x - logical.x - logical.width / 2.0,
+                    y - logical.y - logical.height / 2.0);
+      pango_cairo_show_layout(cr, layout);
+    }
+
+    pango_font_description_free(desc);
+    g_object_unref(layout);
+  }
+
+  cairo_destroy(cr);
+}
+
+/*
+ * Paint the cached dial, which is only drawn again when the size, scale
+ * or color changed, then the hands on top of it.
+ */
+void datetime_analog_face_draw(t_analog_face *face,
+                               GtkWidget *widget,
+                               cairo_t *cr)
+{
+  GtkStyleContext *context = gtk_widget_get_style_context(widget);
+  GdkRGBA color;
+  t_analog_hand *hand;
+  gdouble cx, cy, radius;
+  gint size, scale;
+  guint i;
+
+  gtk_style_context_get_color(context, gtk_style_context_get_state(context), &color);
+  datetime_analog_geometry(widget, &cx, &cy, &radius);
+  size = (gint) (radius * 2);
+  scale = gtk_widget_get_scale_factor(widget);
+
+  if (face->dial == NULL || face->size != size || face->scale != scale ||
+      !gdk_rgba_equal(&face->color, &color))
+  {
+    datetime_analog_face_flush(face);
+    face->size = size;
+    face->scale = scale;
+    face->color = color;
+    datetime_analog_dial_new(face, widget);
+  }
+
+  cairo_set_source_surface(cr, face->dial, cx - size / 2.0, cy - size / 2.0);
+  cairo_paint(cr);
+
+  gdk_cairo_set_source_rgba(cr, &color);
+  cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+  for (i = 0; i < ANALOG_HANDS; i++)
+  {
+    hand = &face->hands[i];
+    if (!hand->visible)
+      continue;
+
+    cairo_set_line_width(cr, datetime_analog_hand_width(hand, radius));
+    cairo_move_to(cr, cx, cy);
+    cairo_line_to(cr, cx + sin(hand->angle) * hand->length * radius,
+                  cy - cos(hand->angle) * hand->length * radius);
+    cairo_stroke(cr);
+  }
+}
@@ -0,0 +1,48 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _DATETIME_ANALOG_H
+#define _DATETIME_ANALOG_H	1
+
+#include <time.h>
+#include <gtk/gtk.h>
+
+/* a clock face drawn from a cached dial, with only the hands drawn per tick */
+typedef struct _t_analog_face t_analog_face;
+
+t_analog_face *
+datetime_analog_face_new(void);
+
+void
+datetime_analog_face_free(t_analog_face *face);
+
+void
+datetime_analog_face_set_time(t_analog_face *face,
+    GtkWidget *widget,
+    const struct tm *tm,
+    gboolean seconds);
+
+void
+datetime_analog_face_draw(t_analog_face *face,
+    GtkWidget *widget,
+    cairo_t *cr);
+
+void
+datetime_analog_face_flush(t_analog_face *face);
+
+#endif /* datetime-analog.h */
@@ -33,6 +33,7 @@
 #include <libxfce4util/libxfce4util.h>
 #include <libxfce4panel/xfce-panel-plugin.h>
 
+#include "datetime-fonts.h"
 #include "datetime.h"
 #include "datetime-dialog.h"
 
@@ -43,7 +44,15 @@ static const gchar *layout_strs[] = {
   N_("Date, then time"),
   N_("Time, then date"),
   N_("Date only"),
-  N_("Time only")
+  N_("Time only"),
+  N_("Analog clock")
+};
+
+/* Calendar views */
+static const gchar *calendar_view_strs[] = {
+  N_("One month"),
+  N_("Three months"),
+  N_("Year")
 };
 
 typedef enum {
@@ -98,6 +107,31 @@ static const dt_combobox_item dt_combobox_time[] = {
 };
 #define DT_COMBOBOX_TIME_COUNT (sizeof(dt_combobox_time)/sizeof(dt_combobox_item))
 
+/* columns of the format combobox models */
+enum {
+  DT_COMBOBOX_COLUMN_INDEX,
+  DT_COMBOBOX_N_COLUMNS
+};
+
+/*
+ * The models are shared by the dialogs of all plugins and built when the
+ * first dialog is created. Example strings are rendered when first shown.
+ */
+static GtkListStore *dt_combobox_date_store = NULL;
+static GtkListStore *dt_combobox_time_store = NULL;
+static gchar *dt_combobox_date_examples[DT_COMBOBOX_DATE_COUNT];
+static gchar *dt_combobox_time_examples[DT_COMBOBOX_TIME_COUNT];
+
+/* columns of the time zone completions */
+enum {
+  DT_ZONE_COLUMN_NAME,
+  DT_ZONE_COLUMN_DESCRIPTION,
+  DT_ZONE_N_COLUMNS
+};
+
+/* most time zones offered while typing */
+#define DT_ZONE_COMPLETIONS 30
+
 /*
  * Example timestamp to show in the dialog.
  * Compute with:
@@ -105,6 +139,40 @@ static const dt_combobox_item dt_combobox_time[] = {
  */
 static const time_t example_time_t = 946684799;
 
+/*
+ * show a font on its button, warning if it is not installed
+ */
+static void datetime_show_font(GtkWidget *button,
+    GtkWidget *label,
+    const gchar *font_name)
+{
+  const t_font_match *match = datetime_font_resolve(label, font_name);
+  PangoFontDescription *desc;
+  const gchar *family;
+  gchar *tooltip = NULL;
+
+  gtk_button_set_label(GTK_BUTTON(button), font_name);
+
+  desc = pango_font_description_from_string(font_name);
+  family = pango_font_description_get_family(desc);
+  if (family == NULL)
+    family = font_name;
+
+  if (!match->installed && match->family != NULL)
+    tooltip = g_strdup_printf(_("%s is not installed, %s is used instead."),
+                              family, match->family);
+  else if (!match->installed)
+    tooltip = g_strdup_printf(_("%s is not installed."), family);
+  else if (match->family != NULL && g_ascii_strcasecmp(family, match->family) != 0)
+    tooltip = g_strdup_printf(_("Shown with %s."), match->family);
+  pango_font_description_free(desc);
+
+  gtk_widget_set_tooltip_text(button, tooltip);
+  gtk_button_set_image(GTK_BUTTON(button), match->installed ? NULL :
+      gtk_image_new_from_icon_name("dialog-warning", GTK_ICON_SIZE_BUTTON));
+  g_free(tooltip);
+}
+
 /*
  * show and read fonts and inform datetime about it
  */
@@ -148,12 +216,16 @@ static void datetime_font_selection_cb(GtkWidget *widget, t_datetime *dt)
 
     if (font_name != NULL)
     {
-      gtk_button_set_label(GTK_BUTTON(widget), font_name);
-
       if(target == DATE)
+      {
         datetime_apply_font(dt, font_name, NULL);
+        datetime_show_font(widget, dt->date_label, font_name);
+      }
       else
+      {
         datetime_apply_font(dt, NULL, font_name);
+        datetime_show_font(widget, dt->time_label, font_name);
+      }
 
       g_free (font_name);
     }
@@ -190,6 +262,14 @@ datetime_layout_changed(GtkComboBox *cbox, t_datetime *dt)
       gtk_widget_hide(dt->time_tooltip_label);
       break;
 
+    case LAYOUT_ANALOG:
+      gtk_widget_hide(dt->date_font_hbox);
+      gtk_widget_show(dt->date_tooltip_label);
+
+      gtk_widget_hide(dt->time_font_hbox);
+      gtk_widget_hide(dt->time_tooltip_label);
+      break;
+
     default:
       gtk_widget_show(dt->date_font_hbox);
       gtk_widget_hide(dt->date_tooltip_label);
@@ -199,7 +279,139 @@ datetime_layout_changed(GtkComboBox *cbox, t_datetime *dt)
   }
 
   datetime_apply_layout(dt, layout);
-  datetime_update(dt);
+}
+
+/*
+ * Read calendar view from combobox
+ */
+static void
+datetime_calendar_view_changed(GtkComboBox *cbox, t_datetime *dt)
+{
+  dt->calendar_view = gtk_combo_box_get_active(cbox);
+}
+
+/*
+ * Describe a zone in a completion, e.g. "Buenos Aires, Argentina (UTC-03:00)"
+ */
+static gchar *
+datetime_zone_description(const t_zone *zone)
+{
+  gint minutes = ABS(zone->offset) / 60;
+  gchar sign = zone->offset < 0 ? '-' : '+';
+
+  if (zone->country != NULL)
+    return g_strdup_printf("%s, %s (UTC%c%02d:%02d)", zone->city, zone->country,
+                           sign, minutes / 60, minutes % 60);
+
+  return g_strdup_printf("%s (UTC%c%02d:%02d)", zone->city,
+                         sign, minutes / 60, minutes % 60);
+}
+
+/*
+ * Offer the zones best matching the text of the time zone entry
+ */
+static void
+datetime_timezone_search(GtkEditable *editable, t_datetime *dt)
+{
+  const t_zone * const *zones;
+  GtkTreeIter iter;
+  gchar *description;
+  guint i, n;
+  gint64 start_time = g_get_monotonic_time();
+
+  gtk_list_store_clear(dt->zone_store);
+
+  /* nothing is offered until the index is loaded */
+  if (dt->zone_search == NULL)
+    return;
+
+  zones = datetime_zone_search_update(dt->zone_search,
+      gtk_entry_get_text(GTK_ENTRY(editable)), &n);
+  for (i = 0; i < MIN(n, DT_ZONE_COMPLETIONS); i++)
+  {
+    description = datetime_zone_description(zones[i]);
+    gtk_list_store_insert_with_values(dt->zone_store, &iter, -1,
+        DT_ZONE_COLUMN_NAME, zones[i]->name,
+        DT_ZONE_COLUMN_DESCRIPTION, description,
+        -1);
+    g_free(description);
+  }
+
+  datetime_report_timing("zone search", start_time);
+}
+
+/*
+ * The completions are already the matches of the search
+ */
+static gboolean
+datetime_timezone_match(GtkEntryCompletion *completion,
+                        const gchar *key,
+                        GtkTreeIter *iter,
+                        gpointer data)
+{
+  return TRUE;
+}
+
+static gboolean
+datetime_timezone_selected(GtkEntryCompletion *completion,
+                           GtkTreeModel *model,
+                           GtkTreeIter *iter,
+                           t_datetime *dt)
+{
+  gchar *name;
+
+  gtk_tree_model_get(model, iter, DT_ZONE_COLUMN_NAME, &name, -1);
+
+  /* the model must not change while the completion is selected from */
+  g_signal_handlers_block_by_func(dt->timezone_entry, datetime_timezone_search, dt);
+  gtk_entry_set_text(GTK_ENTRY(dt->timezone_entry), name);
+  g_signal_handlers_unblock_by_func(dt->timezone_entry, datetime_timezone_search, dt);
+  datetime_apply_timezone(dt, name);
+  g_free(name);
+
+  return TRUE;
+}
+
+/*
+ * Apply the time zone typed into the entry if it exists,
+ * an empty entry for the local time
+ */
+static gboolean
+datetime_timezone_entry_change_cb(GtkWidget *widget, GdkEventFocus *ev, t_datetime *dt)
+{
+  const gchar *name = gtk_entry_get_text(GTK_ENTRY(widget));
+
+  if (*name == '\0' ||
+      (dt->zone_search != NULL &&
+       datetime_zone_index_lookup(datetime_zone_search_get_index(dt->zone_search),
+                                  name) != NULL))
+    datetime_apply_timezone(dt, name);
+  else if (ev != NULL)
+    gtk_entry_set_text(GTK_ENTRY(widget), dt->timezone);
+
+  return FALSE;
+}
+
+static void
+datetime_timezone_entry_activate(GtkEntry *entry, t_datetime *dt)
+{
+  datetime_timezone_entry_change_cb(GTK_WIDGET(entry), NULL, dt);
+}
+
+static void
+datetime_zone_index_loaded(GObject *source, GAsyncResult *result, gpointer data)
+{
+  t_datetime *dt = data;
+  t_zone_index *index;
+
+  /* the plugin is gone if loading was cancelled */
+  index = datetime_zone_index_load_finish(result, NULL);
+  if (index == NULL)
+    return;
+
+  g_clear_object(&dt->zone_cancellable);
+  dt->zone_search = datetime_zone_search_new(index);
+  datetime_zone_index_unref(index);
 }
 
 /*
@@ -245,8 +457,6 @@ date_format_changed(GtkComboBox *cbox, t_datetime *dt)
     default:
       break; /* separators should never be active */
   }
-
-  datetime_update(dt);
 }
 
 /*
@@ -272,8 +482,6 @@ time_format_changed(GtkComboBox *cbox, t_datetime *dt)
     default:
       break; /* separators should never be active */
   }
-
-  datetime_update(dt);
 }
 
 /*
@@ -291,10 +499,122 @@ datetime_entry_change_cb(GtkWidget *widget, GdkEventFocus *ev, t_datetime *dt)
     else if(widget == dt->time_format_entry)    /* or time */
       datetime_apply_format(dt, NULL, format);
   }
-  datetime_update(dt);
   return FALSE;
 }
 
+/*
+ * Get the model of a format combobox, building it the first time
+ */
+static GtkTreeModel *
+datetime_format_model(GtkListStore **store, guint n_items)
+{
+  guint i;
+
+  if (*store == NULL)
+  {
+    *store = gtk_list_store_new(DT_COMBOBOX_N_COLUMNS, G_TYPE_UINT);
+    for (i = 0; i < n_items; i++)
+      gtk_list_store_insert_with_values(*store, NULL, -1,
+                                        DT_COMBOBOX_COLUMN_INDEX, i, -1);
+  }
+
+  return GTK_TREE_MODEL(*store);
+}
+
+/*
+ * Show a row of a format combobox, rendering its example the first time
+ */
+static void
+datetime_format_cell_data(GtkCellLayout   *layout,
+                          GtkCellRenderer *cell,
+                          GtkTreeModel    *model,
+                          GtkTreeIter     *iter,
+                          gpointer         data)
+{
+  const dt_combobox_item *items = (const dt_combobox_item *)data;
+  gchar **examples;
+  struct tm exampletm;
+  t_datetime_format *format;
+  gchar buf[DATETIME_TEXT_SIZE];
+  const gchar *text;
+  guint i;
+
+  examples = (items == dt_combobox_date) ? dt_combobox_date_examples
+                                         : dt_combobox_time_examples;
+  gtk_tree_model_get(model, iter, DT_COMBOBOX_COLUMN_INDEX, &i, -1);
+
+  switch(items[i].type)
+  {
+    case DT_COMBOBOX_ITEM_TYPE_STANDARD:
+      if (examples[i] == NULL)
+      {
+        gmtime_r(&example_time_t, &exampletm);
+        format = datetime_format_new(items[i].item);
+        if (datetime_format_render(format, NULL, &exampletm, buf, sizeof(buf)) == 0)
+          g_strlcpy(buf, _("Invalid format"), sizeof(buf));
+        datetime_format_free(format);
+        examples[i] = g_strdup(buf);
+      }
+      text = examples[i];
+      break;
+    case DT_COMBOBOX_ITEM_TYPE_CUSTOM:
+      text = _(items[i].item);
+      break;
+    default: /* placeholder item does not need to be translated */
+      text = items[i].item;
+      break;
+  }
+
+  g_object_set(cell, "text", text, NULL);
+}
+
+/*
+ * Create a combobox for the date or time format
+ */
+static GtkWidget *
+datetime_format_combobox_new(const dt_combobox_item *items,
+                             GtkListStore **store,
+                             guint n_items)
+{
+  GtkWidget *combobox;
+  GtkCellRenderer *renderer;
+
+  combobox = gtk_combo_box_new_with_model(datetime_format_model(store, n_items));
+  renderer = gtk_cell_renderer_text_new();
+  gtk_cell_layout_pack_start(GTK_CELL_LAYOUT(combobox), renderer, TRUE);
+  gtk_cell_layout_set_cell_data_func(GTK_CELL_LAYOUT(combobox), renderer,
+                                     datetime_format_cell_data,
+                                     (gpointer)items, NULL);
+  gtk_combo_box_set_row_separator_func(GTK_COMBO_BOX(combobox),
+                                       combo_box_row_separator,
+                                       (gpointer)items, NULL);
+
+  return combobox;
+}
+
+/*
+ * Get the item of a format, or the custom item if it is not builtin
+ */
+static gint
+datetime_format_item(const dt_combobox_item *items,
+                     guint n_items,
+                     const gchar *format)
+{
+  gint i_custom = 0; /* index of custom menu item */
+  guint i;
+
+  for (i = 0; i < n_items; i++)
+  {
+    if (items[i].type == DT_COMBOBOX_ITEM_TYPE_STANDARD &&
+        g_strcmp0(format, items[i].item) == 0)
+      return i;
+    if (items[i].type == DT_COMBOBOX_ITEM_TYPE_CUSTOM)
+      i_custom = i;
+  }
+
+  return i_custom;
+}
+
 /*
  * user closed the properties dialog
  */
@@ -316,9 +636,8 @@ datetime_dialog_response(GtkWidget *dlg, int response, t_datetime *dt)
   }
   else
   {
-    g_object_set_data(G_OBJECT(dt->plugin), "dialog", NULL);
-
-    gtk_widget_destroy(dlg);
+    /* keep the dialog for the next time */
+    gtk_widget_hide(dlg);
     datetime_write_rc_file(dt->plugin, dt);
   }
 }
@@ -344,19 +663,19 @@ get_frame_box (const gchar  *label,
 }
 
 /*
- * show datetime properties dialog
+ * create datetime properties dialog
  */
-void
-datetime_properties_dialog(XfcePanelPlugin *plugin, t_datetime * datetime)
+static GtkWidget *
+datetime_dialog_new(XfcePanelPlugin *plugin, t_datetime * datetime)
 {
   guint i;
   gchar *str;
-  struct tm *exampletm = gmtime(&example_time_t);
   GtkWidget *dlg,
             *frame,
             *vbox,
             *hbox,
             *layout_combobox,
+            *calendar_combobox,
             *time_combobox,
             *date_combobox,
             *label,
@@ -364,9 +683,8 @@ datetime_properties_dialog(XfcePanelPlugin *plugin, t_datetime * datetime)
             *entry,
             *bin;
   GtkSizeGroup  *sg;
-  gint i_custom; /* index of custom menu item */
-
-  xfce_textdomain (GETTEXT_PACKAGE, LOCALEDIR, "UTF-8");
+  GtkEntryCompletion *completion;
+  GtkCellRenderer *renderer;
 
   dlg = xfce_titled_dialog_new_with_buttons(_("Datetime"),
       GTK_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(plugin))),
@@ -376,6 +694,10 @@ datetime_properties_dialog(XfcePanelPlugin *plugin, t_datetime * datetime)
       NULL);
 
   g_object_set_data(G_OBJECT(plugin), "dialog", dlg);
+  g_signal_connect(dlg, "delete-event",
+      G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+  g_signal_connect(dlg, "destroy",
+      G_CALLBACK(gtk_widget_destroyed), &datetime->dialog);
 
   gtk_window_set_position (GTK_WINDOW (dlg), GTK_WIN_POS_CENTER);
   gtk_window_set_icon_name (GTK_WINDOW (dlg), "xfce4-settings");
@@ -412,9 +734,72 @@ datetime_properties_dialog(XfcePanelPlugin *plugin, t_datetime * datetime)
   gtk_box_pack_start(GTK_BOX(hbox), layout_combobox, TRUE, TRUE, 0);
   for(i=0; i < LAYOUT_COUNT; i++)
     gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(layout_combobox), _(layout_strs[i]));
-  gtk_combo_box_set_active(GTK_COMBO_BOX(layout_combobox), datetime->layout);
   g_signal_connect(G_OBJECT(layout_combobox), "changed",
       G_CALLBACK(datetime_layout_changed), datetime);
+  datetime->layout_combobox = layout_combobox;
+
+  /* hbox */
+  hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+  gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
+
+  /* Calendar label */
+  label = gtk_label_new(_("Calendar:"));
+  gtk_label_set_xalign (GTK_LABEL (label), 0.0f);
+  gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+  gtk_size_group_add_widget(sg, label);
+
+  /* Calendar view combobox */
+  calendar_combobox = gtk_combo_box_text_new();
+  gtk_box_pack_start(GTK_BOX(hbox), calendar_combobox, TRUE, TRUE, 0);
+  for(i=0; i < CALENDAR_VIEW_COUNT; i++)
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(calendar_combobox), _(calendar_view_strs[i]));
+  g_signal_connect(G_OBJECT(calendar_combobox), "changed",
+      G_CALLBACK(datetime_calendar_view_changed), datetime);
+  datetime->calendar_combobox = calendar_combobox;
+
+  /* hbox */
+  hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+  gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
+
+  /* time zone label */
+  label = gtk_label_new(_("Time zone:"));
+  gtk_label_set_xalign (GTK_LABEL (label), 0.0f);
+  gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+  gtk_size_group_add_widget(sg, label);
+
+  /* time zone entry, completed from the zones matching its text */
+  entry = gtk_entry_new();
+  gtk_entry_set_placeholder_text(GTK_ENTRY(entry), _("Local time"));
+  gtk_box_pack_start(GTK_BOX(hbox), entry, TRUE, TRUE, 0);
+  g_signal_connect(G_OBJECT(entry), "changed",
+      G_CALLBACK(datetime_timezone_search), datetime);
+  g_signal_connect(G_OBJECT(entry), "activate",
+      G_CALLBACK(datetime_timezone_entry_activate), datetime);
+  g_signal_connect(G_OBJECT(entry), "focus-out-event",
+      G_CALLBACK(datetime_timezone_entry_change_cb), datetime);
+  datetime->timezone_entry = entry;
+
+  datetime->zone_store = gtk_list_store_new(DT_ZONE_N_COLUMNS,
+                                            G_TYPE_STRING, G_TYPE_STRING);
+  completion = gtk_entry_completion_new();
+  gtk_entry_completion_set_model(completion, GTK_TREE_MODEL(datetime->zone_store));
+  g_object_unref(datetime->zone_store);
+  gtk_entry_completion_set_text_column(completion, DT_ZONE_COLUMN_NAME);
+  gtk_entry_completion_set_match_func(completion, datetime_timezone_match, NULL, NULL);
+  renderer = gtk_cell_renderer_text_new();
+  g_object_set(renderer, "foreground", "gray", NULL);
+  gtk_cell_layout_pack_start(GTK_CELL_LAYOUT(completion), renderer, FALSE);
+  gtk_cell_layout_add_attribute(GTK_CELL_LAYOUT(completion), renderer,
+                                "text", DT_ZONE_COLUMN_DESCRIPTION);
+  g_signal_connect(G_OBJECT(completion), "match-selected",
+      G_CALLBACK(datetime_timezone_selected), datetime);
+  gtk_entry_set_completion(GTK_ENTRY(entry), completion);
+  g_object_unref(completion);
+
+  /* the zones are indexed in a thread while the dialog opens */
+  datetime->zone_cancellable = g_cancellable_new();
+  datetime_zone_index_load(datetime->zone_cancellable,
+                           datetime_zone_index_loaded, datetime);
 
   /* show frame */
   gtk_widget_show_all(frame);
@@ -450,8 +835,9 @@ datetime_properties_dialog(XfcePanelPlugin *plugin, t_datetime * datetime)
   gtk_size_group_add_widget(sg, label);
 
   /* font button */
-  button = gtk_button_new_with_label(datetime->date_font);
+  button = gtk_button_new_with_label(NULL);
   gtk_box_pack_start(GTK_BOX(datetime->date_font_hbox), button, TRUE, TRUE, 0);
+  gtk_button_set_always_show_image(GTK_BUTTON(button), TRUE);
   g_signal_connect(G_OBJECT(button), "clicked",
       G_CALLBACK(datetime_font_selection_cb), datetime);
   datetime->date_font_selector = button;
@@ -467,47 +853,15 @@ datetime_properties_dialog(XfcePanelPlugin *plugin, t_datetime * datetime)
   gtk_size_group_add_widget(sg, label);
 
   /* format combobox */
-  date_combobox = gtk_combo_box_text_new();
+  date_combobox = datetime_format_combobox_new(dt_combobox_date,
+      &dt_combobox_date_store, DT_COMBOBOX_DATE_COUNT);
   gtk_box_pack_start(GTK_BOX(hbox), date_combobox, TRUE, TRUE, 0);
-  i_custom = 0;
-  for(i=0; i < DT_COMBOBOX_DATE_COUNT; i++)
-  {
-    switch(dt_combobox_date[i].type)
-    {
-      case DT_COMBOBOX_ITEM_TYPE_STANDARD:
-        str = datetime_do_utf8strftime(dt_combobox_date[i].item, exampletm);
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(date_combobox), str);
-        g_free(str);
-        /* set active
-         * strcmp isn't fast, but it is done only once while opening the dialog
-         */
-        if(strcmp(datetime->date_format, dt_combobox_date[i].item) == 0)
-          gtk_combo_box_set_active(GTK_COMBO_BOX(date_combobox), i);
-        break;
-      case DT_COMBOBOX_ITEM_TYPE_CUSTOM:
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(date_combobox), _(dt_combobox_date[i].item));
-        i_custom = i;
-        break;
-      case DT_COMBOBOX_ITEM_TYPE_SEPARATOR: /* placeholder item does not need to be translated */
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(date_combobox), dt_combobox_date[i].item);
-        break;
-      default:
-        break;
-    }
-  }
-  /* if no item activated -> activate custom item */
-  if(gtk_combo_box_get_active(GTK_COMBO_BOX(date_combobox)) < 0)
-    gtk_combo_box_set_active(GTK_COMBO_BOX(date_combobox), i_custom);
-  gtk_combo_box_set_row_separator_func(GTK_COMBO_BOX(date_combobox),
-                                       combo_box_row_separator,
-                                       (gpointer)dt_combobox_date, NULL);
   g_signal_connect(G_OBJECT(date_combobox), "changed",
       G_CALLBACK(date_format_changed), datetime);
   datetime->date_format_combobox = date_combobox;
 
   /* format entry */
   entry = gtk_entry_new();
-  gtk_entry_set_text(GTK_ENTRY(entry), datetime->date_format);
   gtk_widget_set_halign (GTK_WIDGET (entry), GTK_ALIGN_END);
   gtk_box_pack_end(GTK_BOX(vbox), entry, FALSE, FALSE, 0);
   g_signal_connect (G_OBJECT(entry), "focus-out-event",
@@ -547,8 +901,9 @@ datetime_properties_dialog(XfcePanelPlugin *plugin, t_datetime * datetime)
   gtk_size_group_add_widget(sg, label);
 
   /* font button */
-  button = gtk_button_new_with_label(datetime->time_font);
+  button = gtk_button_new_with_label(NULL);
   gtk_box_pack_start(GTK_BOX(datetime->time_font_hbox), button, TRUE, TRUE, 0);
+  gtk_button_set_always_show_image(GTK_BUTTON(button), TRUE);
   g_signal_connect(G_OBJECT(button), "clicked",
       G_CALLBACK(datetime_font_selection_cb), datetime);
   datetime->time_font_selector = button;
@@ -564,47 +919,15 @@ datetime_properties_dialog(XfcePanelPlugin *plugin, t_datetime * datetime)
   gtk_size_group_add_widget(sg, label);
 
   /* format combobox */
-  time_combobox = gtk_combo_box_text_new();
+  time_combobox = datetime_format_combobox_new(dt_combobox_time,
+      &dt_combobox_time_store, DT_COMBOBOX_TIME_COUNT);
   gtk_box_pack_start(GTK_BOX(hbox), time_combobox, TRUE, TRUE, 0);
-  i_custom = 0;
-  for(i=0; i < DT_COMBOBOX_TIME_COUNT; i++)
-  {
-    switch(dt_combobox_time[i].type)
-    {
-      case DT_COMBOBOX_ITEM_TYPE_STANDARD:
-        str = datetime_do_utf8strftime(dt_combobox_time[i].item, exampletm);
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(time_combobox), str);
-        g_free(str);
-        /* set active
-         * strcmp isn't fast, but it is done only once while opening the dialog
-         */
-        if(strcmp(datetime->time_format, dt_combobox_time[i].item) == 0)
-          gtk_combo_box_set_active(GTK_COMBO_BOX(time_combobox), i);
-        break;
-      case DT_COMBOBOX_ITEM_TYPE_CUSTOM:
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(time_combobox), _(dt_combobox_time[i].item));
-        i_custom = i;
-        break;
-      case DT_COMBOBOX_ITEM_TYPE_SEPARATOR: /* placeholder item does not need to be translated */
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(time_combobox), dt_combobox_time[i].item);
-        break;
-      default:
-        break;
-    }
-  }
-  /* if no item activated -> activate custom item */
-  if(gtk_combo_box_get_active(GTK_COMBO_BOX(time_combobox)) < 0)
-    gtk_combo_box_set_active(GTK_COMBO_BOX(time_combobox), i_custom);
-  gtk_combo_box_set_row_separator_func(GTK_COMBO_BOX(time_combobox),
-                                       combo_box_row_separator,
-                                       (gpointer)dt_combobox_time, NULL);
   g_signal_connect(G_OBJECT(time_combobox), "changed",
       G_CALLBACK(time_format_changed), datetime);
   datetime->time_format_combobox = time_combobox;
 
   /* format entry */
   entry = gtk_entry_new();
-  gtk_entry_set_text(GTK_ENTRY(entry), datetime->time_format);
   gtk_widget_set_halign (GTK_WIDGET (entry), GTK_ALIGN_END);
   gtk_box_pack_end(GTK_BOX(vbox), entry, FALSE, FALSE, 0);
   g_signal_connect (G_OBJECT(entry), "focus-out-event",
@@ -617,12 +940,72 @@ datetime_properties_dialog(XfcePanelPlugin *plugin, t_datetime * datetime)
   g_signal_connect(dlg, "response",
       G_CALLBACK(datetime_dialog_response), datetime);
 
+  return dlg;
+}
+
+/*
+ * show the current settings in the dialog
+ */
+static void
+datetime_dialog_sync(t_datetime *datetime)
+{
+  gtk_combo_box_set_active(GTK_COMBO_BOX(datetime->layout_combobox),
+                           datetime->layout);
+  gtk_combo_box_set_active(GTK_COMBO_BOX(datetime->calendar_combobox),
+                           datetime->calendar_view);
+  gtk_entry_set_text(GTK_ENTRY(datetime->timezone_entry), datetime->timezone);
+
+  datetime_show_font(datetime->date_font_selector, datetime->date_label,
+                     datetime->date_font);
+  datetime_show_font(datetime->time_font_selector, datetime->time_label,
+                     datetime->time_font);
+
+  gtk_entry_set_text(GTK_ENTRY(datetime->date_format_entry), datetime->date_format);
+  gtk_entry_set_text(GTK_ENTRY(datetime->time_format_entry), datetime->time_format);
+
+  gtk_combo_box_set_active(GTK_COMBO_BOX(datetime->date_format_combobox),
+                           datetime_format_item(dt_combobox_date,
+                                                DT_COMBOBOX_DATE_COUNT,
+                                                datetime->date_format));
+  gtk_combo_box_set_active(GTK_COMBO_BOX(datetime->time_format_combobox),
+                           datetime_format_item(dt_combobox_time,
+                                                DT_COMBOBOX_TIME_COUNT,
+                                                datetime->time_format));
+
   /* set sensitivity for all widgets */
-  datetime_layout_changed(GTK_COMBO_BOX(layout_combobox), datetime);
-  date_format_changed(GTK_COMBO_BOX(date_combobox), datetime);
-  time_format_changed(GTK_COMBO_BOX(time_combobox), datetime);
+  datetime_layout_changed(GTK_COMBO_BOX(datetime->layout_combobox), datetime);
+  date_format_changed(GTK_COMBO_BOX(datetime->date_format_combobox), datetime);
+  time_format_changed(GTK_COMBO_BOX(datetime->time_format_combobox), datetime);
+}
+
+/*
+ * show settings which changed while the dialog is open
+ */
+void
+datetime_dialog_refresh(t_datetime *datetime)
+{
+  if (datetime->dialog != NULL && gtk_widget_get_visible(datetime->dialog))
+    datetime_dialog_sync(datetime);
+}
+
+/*
+ * show datetime properties dialog, which is only created the first time
+ */
+void
+datetime_properties_dialog(XfcePanelPlugin *plugin, t_datetime * datetime)
+{
+  gint64 start_time = g_get_monotonic_time();
+
+  xfce_textdomain (GETTEXT_PACKAGE, LOCALEDIR, "UTF-8");
+
+  if (datetime->dialog == NULL)
+    datetime->dialog = datetime_dialog_new(plugin, datetime);
+
+  datetime_dialog_sync(datetime);
 
   /* show dialog */
-  gtk_widget_show(dlg);
+  gtk_window_present(GTK_WINDOW(datetime->dialog));
+
+  datetime_report_timing("dialog", start_time);
 }
 
@@ -21,8 +21,15 @@
 #ifndef _DATETIME_DIALOG_H
 #define _DATETIME_DIALOG_H	1
 
+#include <libxfce4panel/libxfce4panel.h>
+
+#include "datetime.h"
+
 void
 datetime_properties_dialog(XfcePanelPlugin *plugin, t_datetime * datetime);
 
+void
+datetime_dialog_refresh(t_datetime *datetime);
+
 #endif /* datetime-dialog.h */
 
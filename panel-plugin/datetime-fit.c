@@ -0,0 +1,147 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "datetime-fit.h"
+
+/* range of font sizes in points */
+#define FIT_MIN_SIZE 4
+#define FIT_MAX_SIZE 128
+
+/*
+ * Line heights in pixels of a font for every size, measured when first
+ * needed. Keyed by the font without its size and by the screen resolution.
+ */
+static GHashTable *fit_metrics = NULL;
+
+static gint * datetime_fit_heights(PangoContext *context,
+                                   const PangoFontDescription *font)
+{
+  PangoFontDescription *family;
+  gchar *name;
+  gchar *key;
+  gint *heights;
+  gint size;
+
+  if (fit_metrics == NULL)
+    fit_metrics = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+  family = pango_font_description_copy_static(font);
+  pango_font_description_unset_fields(family, PANGO_FONT_MASK_SIZE);
+  name = pango_font_description_to_string(family);
+  key = g_strdup_printf("%s@%g", name,
+                        pango_cairo_context_get_resolution(context));
+  pango_font_description_free(family);
+  g_free(name);
+
+  heights = g_hash_table_lookup(fit_metrics, key);
+  if (heights == NULL)
+  {
+    heights = g_new(gint, FIT_MAX_SIZE + 1);
+    for (size = 0; size <= FIT_MAX_SIZE; size++)
+      heights[size] = -1;
+    g_hash_table_insert(fit_metrics, key, heights);
+  }
+  else
+    g_free(key);
+
+  return heights;
+}
+
+/*
+ * Height of a line in the font at a size, from the cache if it is known
+ */
+static gint datetime_fit_height(PangoContext *context,
+                                const PangoFontDescription *font,
+                                gint *heights,
+                                gint size)
+{
+  PangoFontDescription *sized;
+  PangoFontMetrics *metrics;
+
+  size = CLAMP(size, FIT_MIN_SIZE, FIT_MAX_SIZE);
+  if (heights[size] < 0)
+  {
+    sized = pango_font_description_copy_static(font);
+    pango_font_description_set_size(sized, size * PANGO_SCALE);
+    metrics = pango_context_get_metrics(context, sized, NULL);
+    heights[size] = PANGO_PIXELS_CEIL(pango_font_metrics_get_ascent(metrics) +
+                                      pango_font_metrics_get_descent(metrics));
+    pango_font_metrics_unref(metrics);
+    pango_font_description_free(sized);
+  }
+
+  return heights[size];
+}
+
+/*
+ * Find how many points to add to the size of every font, so that their
+ * lines on top of each other are as high as possible but not higher than
+ * available pixels. The search only measures sizes not seen before.
+ */
+gint datetime_fit_delta(GtkWidget *widget,
+    PangoFontDescription **fonts,
+    guint n_fonts,
+    gint available)
+{
+  PangoContext *context = gtk_widget_get_pango_context(widget);
+  gint **heights;
+  gint *sizes;
+  gint smallest = FIT_MAX_SIZE;
+  gint largest = FIT_MIN_SIZE;
+  gint low, high, delta;
+  gint total;
+  guint i;
+
+  if (n_fonts == 0)
+    return 0;
+  heights = g_newa(gint *, n_fonts);
+  sizes = g_newa(gint, n_fonts);
+
+  for (i = 0; i < n_fonts; i++)
+  {
+    heights[i] = datetime_fit_heights(context, fonts[i]);
+    sizes[i] = pango_font_description_get_size(fonts[i]) / PANGO_SCALE;
+    smallest = MIN(smallest, sizes[i]);
+    largest = MAX(largest, sizes[i]);
+  }
+
+  /* binary search for the largest delta that fits */
+  low = FIT_MIN_SIZE - smallest;
+  high = FIT_MAX_SIZE - largest;
+  while (low < high)
+  {
+    delta = low + (high - low + 1) / 2;
+    total = 0;
+    for (i = 0; i < n_fonts; i++)
+      total += datetime_fit_height(context, fonts[i], heights[i], sizes[i] + delta);
+
+    if (total <= available)
+      low = delta;
+    else
+      high = delta - 1;
+  }
+
+  return low;
+}
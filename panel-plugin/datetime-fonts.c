@@ -0,0 +1,160 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* local includes */
+#include <string.h>
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "datetime-fonts.h"
+
+/* families which fontconfig substitutes by design */
+static const gchar *generic_families[] = {
+  "sans", "sans-serif", "serif", "monospace", "cursive", "fantasy", "system-ui"
+};
+
+/* configured font -> t_font_match, until fontconfig changes */
+static GHashTable *font_matches = NULL;
+
+/* folded names of the installed families */
+static GHashTable *font_families = NULL;
+
+static void datetime_font_match_free(t_font_match *match)
+{
+  g_free(match->font);
+  g_free(match->family);
+  g_slice_free(t_font_match, match);
+}
+
+static gboolean datetime_font_family_installed(PangoContext *context,
+                                               const gchar *family)
+{
+  PangoFontFamily **families;
+  gchar *folded;
+  gboolean installed;
+  gint n_families, i;
+
+  if (font_families == NULL)
+  {
+    font_families = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    pango_context_list_families(context, &families, &n_families);
+    for (i = 0; i < n_families; i++)
+      g_hash_table_add(font_families,
+          g_utf8_casefold(pango_font_family_get_name(families[i]), -1));
+    g_free(families);
+  }
+
+  folded = g_utf8_casefold(family, -1);
+  installed = g_hash_table_contains(font_families, folded);
+  for (i = 0; !installed && i < (gint) G_N_ELEMENTS(generic_families); i++)
+    installed = strcmp(folded, generic_families[i]) == 0;
+  g_free(folded);
+
+  return installed;
+}
+
+static t_font_match * datetime_font_match_new(PangoContext *context,
+                                              const gchar *font_name)
+{
+  t_font_match *match = g_slice_new0(t_font_match);
+  PangoFontDescription *desc, *actual;
+  PangoFont *font;
+  const gchar *family;
+  gchar **families;
+  guint i;
+
+  desc = pango_font_description_from_string(font_name);
+
+  /* a list of families matches if any of them is installed */
+  family = pango_font_description_get_family(desc);
+  families = g_strsplit(family != NULL ? family : "", ",", -1);
+  for (i = 0; families[i] != NULL && !match->installed; i++)
+  {
+    g_strstrip(families[i]);
+    match->installed = families[i][0] != '\0' &&
+                       datetime_font_family_installed(context, families[i]);
+  }
+  g_strfreev(families);
+
+  /* the family fontconfig picks, which is then asked for directly */
+  font = pango_context_load_font(context, desc);
+  if (font != NULL)
+  {
+    actual = pango_font_describe(font);
+    match->family = g_strdup(pango_font_description_get_family(actual));
+    pango_font_description_free(actual);
+    g_object_unref(font);
+  }
+
+  if (match->family != NULL)
+    pango_font_description_set_family(desc, match->family);
+  match->font = pango_font_description_to_string(desc);
+  pango_font_description_free(desc);
+
+  DBG("font %s resolved to %s, installed %d", font_name, match->font,
+      match->installed);
+
+  return match;
+}
+
+/*
+ * Find the installed font a configured one is shown with, only the first
+ * time it is asked for. The match is owned by the cache and valid until
+ * datetime_font_flush().
+ */
+const t_font_match * datetime_font_resolve(GtkWidget *widget,
+                                           const gchar *font_name)
+{
+  t_font_match *match;
+
+  if (font_name == NULL)
+    font_name = "";
+
+  if (font_matches == NULL)
+    font_matches = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) datetime_font_match_free);
+
+  match = g_hash_table_lookup(font_matches, font_name);
+  if (match == NULL)
+  {
+    match = datetime_font_match_new(gtk_widget_get_pango_context(widget),
+                                    font_name);
+    g_hash_table_insert(font_matches, g_strdup(font_name), match);
+  }
+
+  return match;
+}
+
+/*
+ * Forget all matches, e.g. after fonts were installed or removed
+ */
+void datetime_font_flush(void)
+{
+  if (font_matches != NULL)
+    g_hash_table_remove_all(font_matches);
+  if (font_families != NULL)
+  {
+    g_hash_table_destroy(font_families);
+    font_families = NULL;
+  }
+}
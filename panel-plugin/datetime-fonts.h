@@ -0,0 +1,38 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _DATETIME_FONTS_H
+#define _DATETIME_FONTS_H	1
+
+#include <gtk/gtk.h>
+
+/* a configured font and the installed one it is shown with */
+typedef struct {
+  gchar *font;        /* the configured font with the family that matched */
+  gchar *family;      /* the installed family */
+  gboolean installed; /* a configured or a generic family is installed */
+} t_font_match;
+
+const t_font_match *
+datetime_font_resolve(GtkWidget *widget,
+    const gchar *font_name);
+
+void
+datetime_font_flush(void);
+
+#endif /* datetime-fonts.h */
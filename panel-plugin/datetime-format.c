@@ -0,0 +1,832 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* local includes */
+#include <time.h>
+#include <string.h>
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+#include <libxfce4panel/libxfce4panel.h>
+
+#include "datetime-altcal.h"
+#include "datetime-format.h"
+#include "datetime-trace.h"
+#include "datetime.h"
+
+/* the time zone offset only changes on multiples of 15 minutes UTC */
+#define FORMAT_ZONE_STEP (15 * 60)
+
+#define SECONDS_PER_DAY (24 * 60 * 60)
+
+typedef enum {
+  FORMAT_LITERAL,       /* bytes of the format copied as they are */
+  FORMAT_YEAR,          /* %Y */
+  FORMAT_YEAR2,         /* %y */
+  FORMAT_MONTH,         /* %m */
+  FORMAT_DAY,           /* %d */
+  FORMAT_DAY_SPACE,     /* %e */
+  FORMAT_HOUR,          /* %H */
+  FORMAT_HOUR_SPACE,    /* %k */
+  FORMAT_HOUR12,        /* %I */
+  FORMAT_HOUR12_SPACE,  /* %l */
+  FORMAT_MINUTE,        /* %M */
+  FORMAT_SECOND,        /* %S */
+  FORMAT_YDAY,          /* %j */
+  FORMAT_WDAY,          /* %w */
+  FORMAT_WDAY_MONDAY,   /* %u */
+  FORMAT_CALENDAR,      /* %(calendar)Y, m, d, e, j or B */
+  FORMAT_STRFTIME       /* anything else, e.g. names, left to strftime() */
+} t_format_op_kind;
+
+typedef struct {
+  t_format_op_kind kind;
+  guint start;          /* offset of the literal or conversion in text */
+  guint len;
+  t_altcal calendar;    /* of FORMAT_CALENDAR, whose text is the field */
+} t_format_op;
+
+struct _t_datetime_format {
+  gchar *text;          /* literals and conversions, each nul terminated */
+  GArray *ops;          /* t_format_op */
+  guint fields;         /* t_datetime_fields the string depends on */
+};
+
+/* two digit strings of 0 to 99, to convert a field without division loops */
+static const gchar format_digits[] =
+  "0001020304050607080910111213141516171819"
+  "2021222324252627282930313233343536373839"
+  "4041424344454647484950515253545556575859"
+  "6061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+/* days before the first of each month in a common year */
+static const guint16 format_month_days[12] = {
+  0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+/* the converter keeps state, so it is used by one thread at a time */
+G_LOCK_DEFINE_STATIC(converter);
+
+/*
+ * Convert a string from the locale's charset to UTF-8 into buf.
+ * The converter is opened once per charset and reused.
+ */
+static gboolean datetime_locale_to_utf8(const gchar *str, gsize len,
+                                        gchar *buf, gsize size)
+{
+  static GIConv converter = (GIConv) -1;
+  static gchar *converter_charset = NULL;
+  const gchar *charset;
+  gchar *inbuf = (gchar *) str;
+  gchar *outbuf = buf;
+  gsize outleft = size - 1;
+  gboolean converted;
+
+  /* strftime() already produced UTF-8 */
+  if (g_get_charset(&charset))
+  {
+    if (len >= size || !g_utf8_validate(str, len, NULL))
+      return FALSE;
+    memcpy(buf, str, len + 1);
+    return TRUE;
+  }
+
+  G_LOCK(converter);
+
+  if (g_strcmp0(converter_charset, charset) != 0)
+  {
+    if (converter != (GIConv) -1)
+      g_iconv_close(converter);
+    converter = g_iconv_open("UTF-8", charset);
+    g_free(converter_charset);
+    converter_charset = g_strdup(charset);
+  }
+
+  converted = FALSE;
+  if (converter != (GIConv) -1)
+  {
+    /* reset the shift state left by a previous conversion */
+    g_iconv(converter, NULL, NULL, NULL, NULL);
+    if (g_iconv(converter, &inbuf, &len, &outbuf, &outleft) != (gsize) -1)
+    {
+      *outbuf = '\0';
+      converted = TRUE;
+    }
+  }
+
+  G_UNLOCK(converter);
+
+  return converted;
+}
+
+/*
+ * Get date/time string into a buffer of DATETIME_TEXT_SIZE bytes,
+ * without allocating memory
+ */
+void datetime_do_utf8strftime_buf(const char *format,
+                                  const struct tm *tm,
+                                  gchar *buf)
+{
+  int len;
+  gchar locale_buf[DATETIME_MAX_STRLEN];
+  gint64 trace_time = datetime_trace_begin();
+
+  /* get formatted date/time */
+  len = strftime(locale_buf, sizeof(locale_buf)-1, format, tm);
+  if (len == 0)
+    g_strlcpy(buf, _("Invalid format"), DATETIME_TEXT_SIZE);
+  else
+  {
+    locale_buf[len] = '\0';  /* make sure nul terminated string */
+    if (!datetime_locale_to_utf8(locale_buf, len, buf, DATETIME_TEXT_SIZE))
+      g_strlcpy(buf, _("Error"), DATETIME_TEXT_SIZE);
+  }
+
+  datetime_trace_end(trace_time, "strftime");
+}
+
+/*
+ * Get date/time string in a locale, or the process locale if it is NULL,
+ * into a buffer of DATETIME_TEXT_SIZE bytes
+ */
+void datetime_do_utf8strftime_l_buf(const char *format,
+                                    const struct tm *tm,
+                                    t_datetime_locale *locale,
+                                    gchar *buf)
+{
+  gint64 trace_time;
+
+  if (locale == NULL)
+  {
+    datetime_do_utf8strftime_buf(format, tm, buf);
+    return;
+  }
+
+  trace_time = datetime_trace_begin();
+
+  if (!datetime_locale_strftime(locale, format, tm, buf, DATETIME_TEXT_SIZE))
+    g_strlcpy(buf, _("Invalid format"), DATETIME_TEXT_SIZE);
+
+  datetime_trace_end(trace_time, "strftime");
+}
+
+/*
+ * Get date/time string in a locale, or the process locale if it is NULL,
+ * into buf. Unlike the functions above, an empty string is a valid result,
+ * e.g. of %p in a locale without AM and PM, and buf is left empty if the
+ * format or the conversion failed.
+ * Returns the length of the string.
+ */
+gsize datetime_utf8strftime_l(const char *format,
+                              const struct tm *tm,
+                              t_datetime_locale *locale,
+                              gchar *buf,
+                              gsize size)
+{
+  gchar locale_buf[DATETIME_MAX_STRLEN];
+  gsize len;
+
+  if (locale != NULL)
+  {
+    if (datetime_locale_strftime(locale, format, tm, buf, size))
+      return strlen(buf);
+  }
+  else
+  {
+    len = strftime(locale_buf, sizeof(locale_buf) - 1, format, tm);
+    locale_buf[len] = '\0';
+    if (len > 0 && datetime_locale_to_utf8(locale_buf, len, buf, size))
+      return strlen(buf);
+  }
+
+  buf[0] = '\0';
+
+  return 0;
+}
+
+static void datetime_format_add(t_datetime_format *format,
+                                GString *text,
+                                t_format_op_kind kind,
+                                const gchar *str,
+                                gsize len)
+{
+  t_format_op *last;
+  t_format_op op;
+
+  /* adjacent literals are copied at once */
+  if (kind == FORMAT_LITERAL && format->ops->len > 0)
+  {
+    last = &g_array_index(format->ops, t_format_op, format->ops->len - 1);
+    if (last->kind == FORMAT_LITERAL)
+    {
+      g_string_truncate(text, text->len - 1);
+      g_string_append_len(text, str, len);
+      g_string_append_c(text, '\0');
+      last->len += len;
+      return;
+    }
+  }
+
+  op.kind = kind;
+  op.start = text->len;
+  op.len = len;
+  g_string_append_len(text, str, len);
+  g_string_append_c(text, '\0');
+  g_array_append_val(format->ops, op);
+}
+
+/*
+ * Add a conversion of another calendar, e.g. %(persian)d, where p points
+ * at the parenthesis. Returns FALSE if it is not one, e.g. an unknown
+ * calendar, and the format is left to strftime() as it is.
+ */
+static gboolean datetime_format_add_calendar(t_datetime_format *format,
+                                             GString *text,
+                                             const gchar **p)
+{
+  const gchar *name = *p + 1;
+  const gchar *close = strchr(name, ')');
+  gint calendar;
+
+  if (close == NULL || close[1] == '\0' || strchr("YmdejB", close[1]) == NULL)
+    return FALSE;
+
+  calendar = datetime_altcal_lookup(name, close - name);
+  if (calendar < 0)
+    return FALSE;
+
+  datetime_format_add(format, text, FORMAT_CALENDAR, close + 1, 1);
+  g_array_index(format->ops, t_format_op, format->ops->len - 1).calendar = calendar;
+  *p = close + 1;
+
+  return TRUE;
+}
+
+/*
+ * The fields a conversion left to strftime() shows, by its conversion
+ * character, the last one of spec
+ */
+static guint datetime_format_spec_fields(const gchar *spec, guint len)
+{
+  if (len < 2)
+    return DATETIME_FIELD_UNKNOWN;
+
+  switch (spec[len - 1])
+  {
+    case 'S':
+    case 's':
+      return DATETIME_FIELD_SECONDS;
+    case 'M':
+      return DATETIME_FIELD_MINUTES;
+    case 'R':
+      return DATETIME_FIELD_MINUTES | DATETIME_FIELD_HOURS;
+    case 'T':
+    case 'r':
+    case 'X':
+      return DATETIME_FIELD_SECONDS | DATETIME_FIELD_MINUTES | DATETIME_FIELD_HOURS;
+    case 'H':
+    case 'I':
+    case 'k':
+    case 'l':
+    case 'p':
+    case 'P':
+      return DATETIME_FIELD_HOURS;
+    case 'a': case 'A': case 'b': case 'B': case 'h': case 'C':
+    case 'd': case 'D': case 'e': case 'F': case 'g': case 'G':
+    case 'j': case 'm': case 'u': case 'U': case 'V': case 'w':
+    case 'W': case 'x': case 'y': case 'Y':
+      return DATETIME_FIELD_DATE;
+    case 'c':
+      return DATETIME_FIELD_SECONDS | DATETIME_FIELD_MINUTES |
+             DATETIME_FIELD_HOURS | DATETIME_FIELD_DATE;
+    case '+':
+      return DATETIME_FIELD_SECONDS | DATETIME_FIELD_MINUTES |
+             DATETIME_FIELD_HOURS | DATETIME_FIELD_DATE | DATETIME_FIELD_ZONE;
+    case 'z':
+    case 'Z':
+      return DATETIME_FIELD_ZONE;
+    case 'n':
+    case 't':
+    case '%':
+      return 0;
+    default:
+      return DATETIME_FIELD_UNKNOWN;
+  }
+}
+
+/*
+ * The fields of the time an operation shows
+ */
+static guint datetime_format_op_fields(const t_datetime_format *format,
+                                       const t_format_op *op)
+{
+  switch (op->kind)
+  {
+    case FORMAT_LITERAL:
+      return 0;
+    case FORMAT_SECOND:
+      return DATETIME_FIELD_SECONDS;
+    case FORMAT_MINUTE:
+      return DATETIME_FIELD_MINUTES;
+    case FORMAT_HOUR:
+    case FORMAT_HOUR_SPACE:
+    case FORMAT_HOUR12:
+    case FORMAT_HOUR12_SPACE:
+      return DATETIME_FIELD_HOURS;
+    case FORMAT_STRFTIME:
+      return datetime_format_spec_fields(format->text + op->start, op->len);
+    default:
+      /* the numeric date fields and those of other calendars */
+      return DATETIME_FIELD_DATE;
+  }
+}
+
+/*
+ * Compile a format. Numeric fields without flags are rendered directly,
+ * all other conversions by strftime() with the locale of the label.
+ * Returns NULL if format is NULL.
+ */
+t_datetime_format * datetime_format_new(const gchar *format_str)
+{
+  t_datetime_format *format;
+  GString *text;
+  const gchar *p, *spec;
+  t_format_op_kind kind;
+  guint i;
+
+  if (format_str == NULL)
+    return NULL;
+
+  format = g_slice_new0(t_datetime_format);
+  format->ops = g_array_new(FALSE, FALSE, sizeof(t_format_op));
+  text = g_string_new(NULL);
+
+  for (p = format_str; *p != '\0'; p++)
+  {
+    if (*p != '%')
+    {
+      spec = p;
+      while (p[1] != '\0' && p[1] != '%')
+        p++;
+      datetime_format_add(format, text, FORMAT_LITERAL, spec, p - spec + 1);
+      continue;
+    }
+
+    /* flags, widths and E or O modifiers are left to strftime() */
+    spec = p++;
+    while (*p != '\0' && strchr("_-0^#EO123456789", *p) != NULL)
+      p++;
+    if (*p == '\0')
+    {
+      datetime_format_add(format, text, FORMAT_STRFTIME, spec, p - spec);
+      break;
+    }
+    if (p - spec > 1)
+    {
+      datetime_format_add(format, text, FORMAT_STRFTIME, spec, p - spec + 1);
+      continue;
+    }
+
+    switch (*p)
+    {
+      case '%': datetime_format_add(format, text, FORMAT_LITERAL, "%", 1); continue;
+      case 'n': datetime_format_add(format, text, FORMAT_LITERAL, "\n", 1); continue;
+      case 't': datetime_format_add(format, text, FORMAT_LITERAL, "\t", 1); continue;
+      case 'F':
+        datetime_format_add(format, text, FORMAT_YEAR, NULL, 0);
+        datetime_format_add(format, text, FORMAT_LITERAL, "-", 1);
+        datetime_format_add(format, text, FORMAT_MONTH, NULL, 0);
+        datetime_format_add(format, text, FORMAT_LITERAL, "-", 1);
+        datetime_format_add(format, text, FORMAT_DAY, NULL, 0);
+        continue;
+      case 'T':
+      case 'R':
+        datetime_format_add(format, text, FORMAT_HOUR, NULL, 0);
+        datetime_format_add(format, text, FORMAT_LITERAL, ":", 1);
+        datetime_format_add(format, text, FORMAT_MINUTE, NULL, 0);
+        if (*p == 'T')
+        {
+          datetime_format_add(format, text, FORMAT_LITERAL, ":", 1);
+          datetime_format_add(format, text, FORMAT_SECOND, NULL, 0);
+        }
+        continue;
+      case 'Y': kind = FORMAT_YEAR; break;
+      case 'y': kind = FORMAT_YEAR2; break;
+      case 'm': kind = FORMAT_MONTH; break;
+      case 'd': kind = FORMAT_DAY; break;
+      case 'e': kind = FORMAT_DAY_SPACE; break;
+      case 'H': kind = FORMAT_HOUR; break;
+      case 'k': kind = FORMAT_HOUR_SPACE; break;
+      case 'I': kind = FORMAT_HOUR12; break;
+      case 'l': kind = FORMAT_HOUR12_SPACE; break;
+      case 'M': kind = FORMAT_MINUTE; break;
+      case 'S': kind = FORMAT_SECOND; break;
+      case 'j': kind = FORMAT_YDAY; break;
+      case 'w': kind = FORMAT_WDAY; break;
+      case 'u': kind = FORMAT_WDAY_MONDAY; break;
+      case '(':
+        if (datetime_format_add_calendar(format, text, &p))
+          continue;
+        kind = FORMAT_STRFTIME;
+        break;
+      default:  kind = FORMAT_STRFTIME; break;
+    }
+
+    if (kind == FORMAT_STRFTIME)
+      datetime_format_add(format, text, kind, spec, 2);
+    else
+      datetime_format_add(format, text, kind, NULL, 0);
+  }
+
+  format->text = g_string_free(text, FALSE);
+
+  for (i = 0; i < format->ops->len; i++)
+    format->fields |= datetime_format_op_fields(format,
+        &g_array_index(format->ops, t_format_op, i));
+
+  return format;
+}
+
+/*
+ * The t_datetime_fields the strings of the format depend on, so that
+ * callers need not sample strftime() to find out when they change
+ */
+guint datetime_format_get_fields(const t_datetime_format *format)
+{
+  return format->fields;
+}
+
+void datetime_format_free(t_datetime_format *format)
+{
+  if (format == NULL)
+    return;
+
+  g_array_free(format->ops, TRUE);
+  g_free(format->text);
+  g_slice_free(t_datetime_format, format);
+}
+
+static inline gchar * datetime_format_put2(gchar *p, gint value)
+{
+  value = CLAMP(value, 0, 99);
+  p[0] = format_digits[value * 2];
+  p[1] = format_digits[value * 2 + 1];
+
+  return p + 2;
+}
+
+/* like datetime_format_put2(), with a space instead of a leading zero */
+static inline gchar * datetime_format_put2_space(gchar *p, gint value)
+{
+  p = datetime_format_put2(p, value);
+  if (p[-2] == '0')
+    p[-2] = ' ';
+
+  return p;
+}
+
+/*
+ * Render one conversion with strftime(), in the locale or the process one.
+ * Conversions that give an empty string, like %p in some locales, are fine.
+ */
+static gsize datetime_format_strftime(const gchar *spec,
+                                      t_datetime_locale *locale,
+                                      const struct tm *tm,
+                                      gchar *buf,
+                                      gsize size)
+{
+  gchar locale_buf[DATETIME_MAX_STRLEN];
+  gsize len;
+
+  if (locale != NULL)
+  {
+    if (!datetime_locale_strftime(locale, spec, tm, buf, size))
+      return 0;
+    return strlen(buf);
+  }
+
+  len = strftime(locale_buf, sizeof(locale_buf) - 1, spec, tm);
+  if (len == 0)
+    return 0;
+  locale_buf[len] = '\0';
+  if (!datetime_locale_to_utf8(locale_buf, len, buf, size))
+    return 0;
+
+  return strlen(buf);
+}
+
+/*
+ * Render a field of the date in another calendar at p, with end being
+ * the last byte for the nul. Dates outside of its tables are shown as "?".
+ * Returns the end of the field, or NULL if a month name did not fit.
+ */
+static gchar * datetime_format_calendar(const t_format_op *op,
+                                        const gchar *field,
+                                        const struct tm *tm,
+                                        gchar *p,
+                                        gchar *end)
+{
+  t_altcal_date date;
+  const gchar *name;
+  gsize len;
+
+  if (!datetime_altcal_convert(op->calendar, tm, &date))
+  {
+    *p++ = '?';
+    return p;
+  }
+
+  switch (*field)
+  {
+    case 'Y':
+      return p + g_snprintf(p, end - p + 1, "%d", date.year);
+    case 'm':
+      return datetime_format_put2(p, date.month);
+    case 'd':
+      return datetime_format_put2(p, date.day);
+    case 'e':
+      return datetime_format_put2_space(p, date.day);
+    case 'j':
+      *p++ = '0' + (date.yday + 1) / 100;
+      return datetime_format_put2(p, (date.yday + 1) % 100);
+    default:
+      name = datetime_altcal_month_name(op->calendar, &date);
+      len = strlen(name);
+      if ((gsize) (end - p) < len)
+        return NULL;
+      memcpy(p, name, len);
+      return p + len;
+  }
+}
+
+/*
+ * Render tm into buf, which holds size bytes including the nul.
+ * Returns the length of the string, or 0 if it is empty or did not fit,
+ * in which case buf is left empty.
+ */
+gsize datetime_format_render(t_datetime_format *format,
+                             t_datetime_locale *locale,
+                             const struct tm *tm,
+                             gchar *buf,
+                             gsize size)
+{
+  const t_format_op *op;
+  gchar *p = buf;
+  gchar *end = buf + size - 1;
+  gint year;
+  guint i;
+  gint64 trace_time = datetime_trace_begin();
+
+  for (i = 0; i < format->ops->len; i++)
+  {
+    op = &g_array_index(format->ops, t_format_op, i);
+
+    /* a numeric field takes at most 11 bytes, e.g. a year of -2147481748 */
+    if (op->kind != FORMAT_LITERAL && op->kind != FORMAT_STRFTIME && end - p < 11)
+      goto overflow;
+
+    switch (op->kind)
+    {
+      case FORMAT_LITERAL:
+        if ((gsize) (end - p) < op->len)
+          goto overflow;
+        memcpy(p, format->text + op->start, op->len);
+        p += op->len;
+        break;
+      case FORMAT_YEAR:
+        year = tm->tm_year + 1900;
+        if (year >= 0 && year <= 9999)
+        {
+          p = datetime_format_put2(p, year / 100);
+          p = datetime_format_put2(p, year % 100);
+        }
+        else
+          p += g_snprintf(p, end - p + 1, "%d", year);
+        break;
+      case FORMAT_YEAR2:
+        year = (tm->tm_year + 1900) % 100;
+        p = datetime_format_put2(p, year < 0 ? -year : year);
+        break;
+      case FORMAT_MONTH:
+        p = datetime_format_put2(p, tm->tm_mon + 1);
+        break;
+      case FORMAT_DAY:
+        p = datetime_format_put2(p, tm->tm_mday);
+        break;
+      case FORMAT_DAY_SPACE:
+        p = datetime_format_put2_space(p, tm->tm_mday);
+        break;
+      case FORMAT_HOUR:
+        p = datetime_format_put2(p, tm->tm_hour);
+        break;
+      case FORMAT_HOUR_SPACE:
+        p = datetime_format_put2_space(p, tm->tm_hour);
+        break;
+      case FORMAT_HOUR12:
+        p = datetime_format_put2(p, (tm->tm_hour + 11) % 12 + 1);
+        break;
+      case FORMAT_HOUR12_SPACE:
+        p = datetime_format_put2_space(p, (tm->tm_hour + 11) % 12 + 1);
+        break;
+      case FORMAT_MINUTE:
+        p = datetime_format_put2(p, tm->tm_min);
+        break;
+      case FORMAT_SECOND:
+        p = datetime_format_put2(p, tm->tm_sec);
+        break;
+      case FORMAT_YDAY:
+        *p++ = '0' + CLAMP(tm->tm_yday + 1, 0, 999) / 100;
+        p = datetime_format_put2(p, (tm->tm_yday + 1) % 100);
+        break;
+      case FORMAT_WDAY:
+        *p++ = '0' + CLAMP(tm->tm_wday, 0, 9);
+        break;
+      case FORMAT_WDAY_MONDAY:
+        *p++ = '0' + (tm->tm_wday == 0 ? 7 : CLAMP(tm->tm_wday, 0, 9));
+        break;
+      case FORMAT_CALENDAR:
+        p = datetime_format_calendar(op, format->text + op->start, tm, p, end);
+        if (p == NULL)
+          goto overflow;
+        break;
+      case FORMAT_STRFTIME:
+        p += datetime_format_strftime(format->text + op->start, locale, tm,
+                                      p, end - p + 1);
+        break;
+    }
+  }
+
+  *p = '\0';
+  datetime_trace_end(trace_time, "format");
+
+  return p - buf;
+
+overflow:
+  buf[0] = '\0';
+  datetime_trace_end(trace_time, "format");
+
+  return 0;
+}
+
+/*
+ * Render n broken-down times into out, every string in its own slot of
+ * stride bytes.
+ */
+void datetime_format_render_batch(t_datetime_format *format,
+                                  t_datetime_locale *locale,
+                                  const struct tm *tms,
+                                  guint n,
+                                  gchar *out,
+                                  gsize stride)
+{
+  guint i;
+
+  for (i = 0; i < n; i++)
+    datetime_format_render(format, locale, &tms[i], out + i * stride, stride);
+}
+
+static inline gint64 datetime_format_floor_div(gint64 a, gint64 b)
+{
+  return a / b - (a % b < 0);
+}
+
+/*
+ * Split days since 1970-01-01 into the date fields of tm,
+ * with the days-to-civil algorithm of the proleptic Gregorian calendar.
+ */
+static void datetime_format_set_date(gint64 days, struct tm *tm)
+{
+  gint64 z = days + 719468;  /* days since 0000-03-01 */
+  gint64 era = datetime_format_floor_div(z, 146097);
+  gint64 doe = z - era * 146097;
+  gint64 yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  gint64 doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  gint64 mp = (5 * doy + 2) / 153;
+  gint64 year = yoe + era * 400;
+  gint month = mp < 10 ? mp + 3 : mp - 9;
+  gboolean leap;
+
+  if (month <= 2)
+    year++;
+  leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+
+  tm->tm_year = year - 1900;
+  tm->tm_mon = month - 1;
+  tm->tm_mday = doy - (153 * mp + 2) / 5 + 1;
+  tm->tm_yday = format_month_days[month - 1] + tm->tm_mday - 1 + (leap && month > 2);
+  tm->tm_wday = days + 4 - 7 * datetime_format_floor_div(days + 4, 7);
+}
+
+/*
+ * Get the offset, daylight saving time flag and abbreviation of a time zone,
+ * or of the local one if tz is NULL, at a time.
+ */
+static void datetime_format_zone(GTimeZone *tz, time_t t, struct tm *zone_tm)
+{
+  gint interval;
+
+  if (tz == NULL)
+  {
+    localtime_r(&t, zone_tm);
+    return;
+  }
+
+  memset(zone_tm, 0, sizeof(*zone_tm));
+  interval = g_time_zone_find_interval(tz, G_TIME_TYPE_UNIVERSAL, t);
+  zone_tm->tm_gmtoff = g_time_zone_get_offset(tz, interval);
+  zone_tm->tm_isdst = g_time_zone_is_dst(tz, interval);
+  zone_tm->tm_zone = g_intern_string(g_time_zone_get_abbreviation(tz, interval));
+}
+
+/*
+ * Convert n timestamps to broken-down times in a time zone,
+ * or in the local one if tz is NULL.
+ * The zone offset is only looked up once per quarter of an hour
+ * the timestamps fall in, and the date is only computed again for another
+ * day, so that sorted timestamps are cheap to decompose.
+ */
+void datetime_format_decompose(const gint64 *stamps,
+                               guint n,
+                               GTimeZone *tz,
+                               struct tm *tms)
+{
+  struct tm zone_tm;
+  gint64 zone_step = G_MININT64;
+  gint64 day = G_MININT64;
+  gint64 step, local, days, seconds;
+  time_t t;
+  guint i;
+
+  for (i = 0; i < n; i++)
+  {
+    step = datetime_format_floor_div(stamps[i], FORMAT_ZONE_STEP);
+    if (step != zone_step)
+    {
+      t = step * FORMAT_ZONE_STEP;
+      datetime_format_zone(tz, t, &zone_tm);
+      zone_step = step;
+      day = G_MININT64;
+    }
+
+    local = stamps[i] + zone_tm.tm_gmtoff;
+    days = datetime_format_floor_div(local, SECONDS_PER_DAY);
+    seconds = local - days * SECONDS_PER_DAY;
+
+    if (days != day)
+    {
+      tms[i] = zone_tm;
+      datetime_format_set_date(days, &tms[i]);
+      day = days;
+    }
+    else
+      tms[i] = tms[i - 1];
+
+    tms[i].tm_hour = seconds / 3600;
+    tms[i].tm_min = seconds / 60 % 60;
+    tms[i].tm_sec = seconds % 60;
+  }
+}
+
+/*
+ * Render n timestamps into out, every string in its own slot of stride bytes.
+ * They are decomposed DATETIME_FORMAT_BATCH at a time.
+ */
+void datetime_format_render_stamps(t_datetime_format *format,
+                                   t_datetime_locale *locale,
+                                   GTimeZone *tz,
+                                   const gint64 *stamps,
+                                   guint n,
+                                   gchar *out,
+                                   gsize stride)
+{
+  struct tm tms[DATETIME_FORMAT_BATCH];
+  guint i, count;
+
+  for (i = 0; i < n; i += count)
+  {
+    count = MIN(n - i, DATETIME_FORMAT_BATCH);
+    datetime_format_decompose(stamps + i, count, tz, tms);
+    datetime_format_render_batch(format, locale, tms, count,
+                                 out + i * stride, stride);
+  }
+}
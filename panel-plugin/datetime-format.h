@@ -0,0 +1,101 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DATETIME_FORMAT_H
+#define _DATETIME_FORMAT_H	1
+
+#include <time.h>
+#include <glib.h>
+
+#include "datetime-locale.h"
+
+/* a strftime() format compiled once into a list of fields and literals */
+typedef struct _t_datetime_format t_datetime_format;
+
+/* timestamps decomposed and rendered at a time by the batch functions */
+#define DATETIME_FORMAT_BATCH 64
+
+/* fields of the time the string of a format depends on */
+typedef enum {
+  DATETIME_FIELD_SECONDS = 1 << 0,
+  DATETIME_FIELD_MINUTES = 1 << 1,
+  DATETIME_FIELD_HOURS   = 1 << 2,
+  DATETIME_FIELD_DATE    = 1 << 3,  /* anything of the day, e.g. a weekday */
+  DATETIME_FIELD_ZONE    = 1 << 4,
+  DATETIME_FIELD_UNKNOWN = 1 << 5   /* conversions strftime() may not know */
+} t_datetime_fields;
+
+t_datetime_format *
+datetime_format_new(const gchar *format);
+
+void
+datetime_format_free(t_datetime_format *format);
+
+guint
+datetime_format_get_fields(const t_datetime_format *format);
+
+gsize
+datetime_format_render(t_datetime_format *format,
+    t_datetime_locale *locale,
+    const struct tm *tm,
+    gchar *buf,
+    gsize size);
+
+void
+datetime_format_render_batch(t_datetime_format *format,
+    t_datetime_locale *locale,
+    const struct tm *tms,
+    guint n,
+    gchar *out,
+    gsize stride);
+
+void
+datetime_format_decompose(const gint64 *stamps,
+    guint n,
+    GTimeZone *tz,
+    struct tm *tms);
+
+void
+datetime_format_render_stamps(t_datetime_format *format,
+    t_datetime_locale *locale,
+    GTimeZone *tz,
+    const gint64 *stamps,
+    guint n,
+    gchar *out,
+    gsize stride);
+
+void
+datetime_do_utf8strftime_buf(
+    const char *format,
+    const struct tm *tm,
+    gchar *buf);
+
+void
+datetime_do_utf8strftime_l_buf(
+    const char *format,
+    const struct tm *tm,
+    t_datetime_locale *locale,
+    gchar *buf);
+
+gsize
+datetime_utf8strftime_l(const char *format,
+    const struct tm *tm,
+    t_datetime_locale *locale,
+    gchar *buf,
+    gsize size);
+
+#endif /* datetime-format.h */
@@ -0,0 +1,262 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+/* local includes */
+#include <string.h>
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+#include <libxfce4panel/libxfce4panel.h>
+
+#include "datetime-job.h"
+#include "datetime.h"
+
+/* a label of the job */
+typedef struct {
+  t_datetime_format *compiled;  /* NULL for a hidden label */
+  t_datetime_markup *markup;    /* attributes of a format with markup, or NULL */
+  t_datetime_locale *locale;    /* opened for the job, or NULL for the process one */
+  guint offsets;                /* index of its bounds in the offsets of a frame */
+} t_render_job_text;
+
+/*
+ * Built on the main loop and not changed once sealed; only the frames are
+ * written to, by whoever acquired them. The frames are allocated with the
+ * job, so that rendering them does not allocate.
+ */
+struct _t_render_job {
+  gint ref_count;
+  guint generation;       /* render_generation it was built in */
+  GTimeZone *tz;          /* zone the time is shown in, or NULL for the local one */
+  guint update_interval;  /* time between updates in milliseconds */
+  guint n_texts;
+  t_render_job_text *texts;
+  guint n_offsets;        /* bounds of the markup of all labels */
+  t_render_frame frames[2];
+};
+
+/*
+ * Start a job of n_texts labels, which are all hidden until they are set
+ */
+t_render_job * datetime_render_job_new(guint generation,
+    GTimeZone *tz,
+    guint update_interval,
+    guint n_texts)
+{
+  t_render_job *job = g_slice_new0(t_render_job);
+
+  job->ref_count = 1;
+  job->generation = generation;
+  job->tz = tz != NULL ? g_time_zone_ref(tz) : NULL;
+  job->update_interval = update_interval;
+  job->n_texts = n_texts;
+  job->texts = g_new0(t_render_job_text, n_texts);
+
+  return job;
+}
+
+/*
+ * Set the format and the locale name of a label before the job is sealed.
+ * A NULL format hides the label.
+ */
+void datetime_render_job_set_text(t_render_job *job,
+    guint i,
+    const gchar *format,
+    const gchar *locale)
+{
+  t_render_job_text *text;
+
+  g_return_if_fail(i < job->n_texts);
+
+  if (format == NULL)
+    return;
+
+  text = &job->texts[i];
+  text->markup = datetime_markup_new(format);
+  text->compiled = datetime_format_new(text->markup != NULL ?
+      datetime_markup_get_format(text->markup) : format);
+  text->locale = datetime_locale_open(locale);
+}
+
+/*
+ * Allocate the frames once all labels are set
+ */
+void datetime_render_job_seal(t_render_job *job)
+{
+  t_render_job_text *text;
+  guint i;
+
+  for (i = 0; i < job->n_texts; i++)
+  {
+    text = &job->texts[i];
+    text->offsets = job->n_offsets;
+    if (text->markup != NULL)
+      job->n_offsets += datetime_markup_get_n_bounds(text->markup);
+  }
+
+  for (i = 0; i < G_N_ELEMENTS(job->frames); i++)
+  {
+    job->frames[i].job = job;
+    job->frames[i].texts = g_malloc0(MAX(job->n_texts, 1) * DATETIME_TEXT_SIZE);
+    job->frames[i].offsets = g_new0(guint, MAX(job->n_offsets, 1));
+  }
+}
+
+t_render_job * datetime_render_job_ref(t_render_job *job)
+{
+  g_atomic_int_inc(&job->ref_count);
+
+  return job;
+}
+
+/*
+ * The last reference may be dropped on the worker, with a frame it replaced
+ */
+void datetime_render_job_unref(t_render_job *job)
+{
+  t_render_job_text *text;
+  guint i;
+
+  if (!g_atomic_int_dec_and_test(&job->ref_count))
+    return;
+
+  for (i = 0; i < job->n_texts; i++)
+  {
+    text = &job->texts[i];
+    datetime_format_free(text->compiled);
+    datetime_markup_free(text->markup);
+    datetime_locale_close(text->locale);
+  }
+  for (i = 0; i < G_N_ELEMENTS(job->frames); i++)
+  {
+    g_free(job->frames[i].texts);
+    g_free(job->frames[i].offsets);
+  }
+  if (job->tz != NULL)
+    g_time_zone_unref(job->tz);
+  g_free(job->texts);
+  g_slice_free(t_render_job, job);
+}
+
+guint datetime_render_job_get_generation(const t_render_job *job)
+{
+  return job->generation;
+}
+
+guint datetime_render_job_get_update_interval(const t_render_job *job)
+{
+  return job->update_interval;
+}
+
+guint datetime_render_job_get_n_texts(const t_render_job *job)
+{
+  return job->n_texts;
+}
+
+/*
+ * A frame to render the strings for stamp into: one that is neither
+ * requested, posted nor held by the main loop. The frame keeps a reference
+ * to the job until it is released. Returns NULL if both frames are in use.
+ */
+t_render_frame * datetime_render_frame_acquire(t_render_job *job, time_t stamp)
+{
+  t_render_frame *frame;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(job->frames); i++)
+  {
+    frame = &job->frames[i];
+    if (g_atomic_int_compare_and_exchange(&frame->in_use, FALSE, TRUE))
+    {
+      datetime_render_job_ref(job);
+      frame->stamp = stamp;
+      frame->gmtoff = 0;
+      return frame;
+    }
+  }
+
+  return NULL;
+}
+
+void datetime_render_frame_release(t_render_frame *frame)
+{
+  t_render_job *job = frame->job;
+
+  g_atomic_int_set(&frame->in_use, FALSE);
+  datetime_render_job_unref(job);
+}
+
+/*
+ * Render the strings of every label for the time of the frame.
+ * Only reads the job, so it may run on any thread that holds the frame.
+ */
+void datetime_render_frame_render(t_render_frame *frame)
+{
+  const t_render_job *job = frame->job;
+  const t_render_job_text *text;
+  gint64 stamp = frame->stamp;
+  struct tm tm;
+  gchar *buf;
+  guint i;
+
+  datetime_format_decompose(&stamp, 1, job->tz, &tm);
+  frame->gmtoff = tm.tm_gmtoff;
+
+  for (i = 0; i < job->n_texts; i++)
+  {
+    text = &job->texts[i];
+    buf = frame->texts + i * DATETIME_TEXT_SIZE;
+
+    if (text->compiled == NULL)
+      buf[0] = '\0';
+    else if (text->markup != NULL)
+      datetime_markup_render_offsets(text->markup, text->locale, &tm, buf,
+                                     frame->offsets + text->offsets);
+    else if (datetime_format_render(text->compiled, text->locale, &tm,
+                                    buf, DATETIME_TEXT_SIZE) == 0)
+      g_strlcpy(buf, _("Invalid format"), DATETIME_TEXT_SIZE);
+  }
+}
+
+const gchar * datetime_render_frame_get_text(const t_render_frame *frame, guint i)
+{
+  return frame->texts + i * DATETIME_TEXT_SIZE;
+}
+
+/*
+ * The offsets of the bounds of the markup of a label, or NULL without markup
+ */
+const guint * datetime_render_frame_get_offsets(const t_render_frame *frame, guint i)
+{
+  const t_render_job_text *text = &frame->job->texts[i];
+
+  return text->markup != NULL ? frame->offsets + text->offsets : NULL;
+}
+
+/*
+ * Whether the label was rendered, rather than hidden
+ */
+gboolean datetime_render_frame_is_shown(const t_render_frame *frame, guint i)
+{
+  return frame->job->texts[i].compiled != NULL;
+}
@@ -0,0 +1,94 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DATETIME_JOB_H
+#define _DATETIME_JOB_H	1
+
+#include <time.h>
+#include <glib.h>
+
+/*
+ * What the worker renders: the labels as the settings were when the job was
+ * built, with formats and locales of its own, so that the worker shares
+ * nothing with the main loop but the frames it hands over.
+ */
+typedef struct _t_render_job t_render_job;
+
+/* strings rendered for a time, posted to the main loop */
+typedef struct {
+  t_render_job *job;      /* the job rendered, referenced while in use */
+  time_t stamp;
+  glong gmtoff;
+  gint64 due;             /* monotonic time the main loop should take it by */
+  gchar *texts;           /* DATETIME_TEXT_SIZE bytes for every label */
+  guint *offsets;         /* bounds of the markup of every label */
+  gint in_use;            /* requested, posted or held by the main loop, atomic */
+} t_render_frame;
+
+t_render_job *
+datetime_render_job_new(guint generation,
+    GTimeZone *tz,
+    guint update_interval,
+    guint n_texts);
+
+void
+datetime_render_job_set_text(t_render_job *job,
+    guint i,
+    const gchar *format,
+    const gchar *locale);
+
+void
+datetime_render_job_seal(t_render_job *job);
+
+t_render_job *
+datetime_render_job_ref(t_render_job *job);
+
+void
+datetime_render_job_unref(t_render_job *job);
+
+guint
+datetime_render_job_get_generation(const t_render_job *job);
+
+guint
+datetime_render_job_get_update_interval(const t_render_job *job);
+
+guint
+datetime_render_job_get_n_texts(const t_render_job *job);
+
+t_render_frame *
+datetime_render_frame_acquire(t_render_job *job,
+    time_t stamp);
+
+void
+datetime_render_frame_release(t_render_frame *frame);
+
+void
+datetime_render_frame_render(t_render_frame *frame);
+
+const gchar *
+datetime_render_frame_get_text(const t_render_frame *frame,
+    guint i);
+
+const guint *
+datetime_render_frame_get_offsets(const t_render_frame *frame,
+    guint i);
+
+gboolean
+datetime_render_frame_is_shown(const t_render_frame *frame,
+    guint i);
+
+#endif /* datetime-job.h */
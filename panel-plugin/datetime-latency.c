@@ -0,0 +1,246 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* local includes */
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "datetime-latency.h"
+
+/* number of updates summarized in one report */
+#define LATENCY_SAMPLES 60
+
+/* room for the report of all stages */
+#define LATENCY_REPORT_SIZE 512
+
+typedef enum {
+  LATENCY_FIRED,        /* the timer fired */
+  LATENCY_SET,          /* the labels were set */
+  LATENCY_PRESENTED,    /* the frame showing them was presented */
+  LATENCY_COUNT
+} t_latency_stage;
+
+static const gchar *latency_stage_names[LATENCY_COUNT] = {
+  "fired", "set", "presented"
+};
+
+/*
+ * Every stage is measured in microseconds from the wall clock boundary
+ * the update was meant for.
+ */
+struct _t_latency {
+  gint64 samples[LATENCY_COUNT][LATENCY_SAMPLES];
+  guint n_samples[LATENCY_COUNT];
+
+  /* the update waiting for its frame to be presented */
+  gboolean pending;
+  gint64 pending_boundary;  /* monotonic time of the boundary */
+  gint64 pending_frame;     /* frame counter, or -1 until painted */
+  gint64 pending_painted;   /* monotonic time the frame was painted */
+
+  GdkFrameClock *clock;
+  gulong paint_handler_id;
+  gint stats_fd;            /* DATETIME_LATENCY_STATS, or -1 */
+};
+
+static gint datetime_latency_compare(gconstpointer a, gconstpointer b)
+{
+  gint64 sample_a = *(const gint64 *) a;
+  gint64 sample_b = *(const gint64 *) b;
+
+  return sample_a < sample_b ? -1 : sample_a > sample_b;
+}
+
+static void datetime_latency_add(t_latency *latency,
+                                 t_latency_stage stage,
+                                 gint64 sample)
+{
+  if (latency->n_samples[stage] < LATENCY_SAMPLES)
+    latency->samples[stage][latency->n_samples[stage]++] = MAX(sample, 0);
+}
+
+/*
+ * Summarize the samples as percentiles, in the debug output and in the
+ * file named by DATETIME_LATENCY_STATS, then start over.
+ * The report is written into a buffer on the stack and the file is kept
+ * open, so that reporting does not allocate.
+ */
+static void datetime_latency_report(t_latency *latency)
+{
+  gchar report[LATENCY_REPORT_SIZE];
+  gsize len = 0;
+  gint64 *samples;
+  guint n;
+  guint i;
+
+  for (i = 0; i < LATENCY_COUNT; i++)
+  {
+    samples = latency->samples[i];
+    n = latency->n_samples[i];
+    if (n == 0)
+      continue;
+
+    qsort(samples, n, sizeof(gint64), datetime_latency_compare);
+    len += g_snprintf(report + len, sizeof(report) - len,
+        "%s: p50 %" G_GINT64_FORMAT " us, p90 %" G_GINT64_FORMAT
+        " us, p99 %" G_GINT64_FORMAT " us, max %" G_GINT64_FORMAT " us (%u samples)\n",
+        latency_stage_names[i],
+        samples[n * 50 / 100], samples[n * 90 / 100],
+        samples[n * 99 / 100], samples[n - 1], n);
+    latency->n_samples[i] = 0;
+    len = MIN(len, sizeof(report) - 1);
+  }
+  report[len] = '\0';
+
+  DBG("latency\n%s", report);
+
+  if (latency->stats_fd >= 0 &&
+      (lseek(latency->stats_fd, 0, SEEK_SET) != 0 ||
+       write(latency->stats_fd, report, len) != (gssize) len ||
+       ftruncate(latency->stats_fd, len) != 0))
+    DBG("cannot write the latency stats");
+}
+
+/*
+ * Take the presentation time of the pending update once the frame clock
+ * knows it. Without presentation times, e.g. without a compositor, the time
+ * the frame was painted is used. Returns FALSE if it is not known yet.
+ */
+static gboolean datetime_latency_resolve(t_latency *latency, gboolean force)
+{
+  GdkFrameTimings *timings = NULL;
+  gint64 presented = 0;
+
+  if (!latency->pending || latency->pending_frame < 0)
+    return FALSE;
+
+  if (latency->clock != NULL)
+    timings = gdk_frame_clock_get_timings(latency->clock, latency->pending_frame);
+
+  if (timings != NULL && !gdk_frame_timings_get_complete(timings) && !force)
+    return FALSE;
+
+  if (timings != NULL && gdk_frame_timings_get_complete(timings))
+    presented = gdk_frame_timings_get_presentation_time(timings);
+  if (presented == 0)
+    presented = latency->pending_painted;
+
+  datetime_latency_add(latency, LATENCY_PRESENTED,
+                       presented - latency->pending_boundary);
+  latency->pending = FALSE;
+
+  return TRUE;
+}
+
+static void datetime_latency_after_paint(GdkFrameClock *clock,
+                                         t_latency *latency)
+{
+  if (!latency->pending)
+    return;
+
+  /* the first frame painted after the labels were set shows them */
+  if (latency->pending_frame < 0)
+  {
+    latency->pending_frame = gdk_frame_clock_get_frame_counter(clock);
+    latency->pending_painted = g_get_monotonic_time();
+    return;
+  }
+
+  datetime_latency_resolve(latency, FALSE);
+}
+
+t_latency * datetime_latency_new(void)
+{
+  t_latency *latency = g_slice_new0(t_latency);
+  const gchar *stats_file = g_getenv("DATETIME_LATENCY_STATS");
+
+  latency->stats_fd = -1;
+  if (stats_file != NULL)
+    latency->stats_fd = open(stats_file, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+
+  return latency;
+}
+
+void datetime_latency_free(t_latency *latency)
+{
+  if (latency->paint_handler_id != 0)
+    g_signal_handler_disconnect(latency->clock, latency->paint_handler_id);
+  if (latency->clock != NULL)
+    g_object_unref(latency->clock);
+  if (latency->stats_fd >= 0)
+    close(latency->stats_fd);
+  g_slice_free(t_latency, latency);
+}
+
+/*
+ * Record an update woken by the timer which changed the labels of widget.
+ * boundary, fired and set are wall clock times in microseconds.
+ * Without a widget, only the stages up to setting the labels are measured.
+ */
+void datetime_latency_tick(t_latency *latency,
+    GtkWidget *widget,
+    gint64 boundary,
+    gint64 fired,
+    gint64 set)
+{
+  GdkFrameClock *clock = widget != NULL ? gtk_widget_get_frame_clock(widget) : NULL;
+
+  /* the frame clock changes when the panel is moved to another screen */
+  if (clock != latency->clock)
+  {
+    if (latency->paint_handler_id != 0)
+      g_signal_handler_disconnect(latency->clock, latency->paint_handler_id);
+    if (latency->clock != NULL)
+      g_object_unref(latency->clock);
+    latency->clock = clock;
+    latency->paint_handler_id = 0;
+    latency->pending = FALSE;
+    if (clock != NULL)
+    {
+      g_object_ref(clock);
+      latency->paint_handler_id = g_signal_connect(clock, "after-paint",
+          G_CALLBACK(datetime_latency_after_paint), latency);
+    }
+  }
+
+  /* the previous update has certainly been painted by now */
+  datetime_latency_resolve(latency, TRUE);
+
+  datetime_latency_add(latency, LATENCY_FIRED, fired - boundary);
+  datetime_latency_add(latency, LATENCY_SET, set - boundary);
+
+  if (clock != NULL)
+  {
+    /* the frame clock counts in monotonic time */
+    latency->pending = TRUE;
+    latency->pending_boundary = g_get_monotonic_time() - (set - boundary);
+    latency->pending_frame = -1;
+  }
+
+  if (latency->n_samples[LATENCY_FIRED] == LATENCY_SAMPLES)
+    datetime_latency_report(latency);
+}
@@ -0,0 +1,39 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DATETIME_LATENCY_H
+#define _DATETIME_LATENCY_H	1
+
+#include <gtk/gtk.h>
+
+/* measures how late updates reach the screen */
+typedef struct _t_latency t_latency;
+
+t_latency *
+datetime_latency_new(void);
+
+void
+datetime_latency_free(t_latency *latency);
+
+void
+datetime_latency_tick(t_latency *latency,
+    GtkWidget *widget,
+    gint64 boundary,
+    gint64 fired,
+    gint64 set);
+
+#endif /* datetime-latency.h */
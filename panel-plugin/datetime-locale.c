@@ -0,0 +1,186 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* local includes */
+#include <time.h>
+#include <string.h>
+#include <locale.h>
+#include <langinfo.h>
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "datetime-locale.h"
+
+/* longest string strftime() may produce in a legacy codeset */
+#define LOCALE_MAX_STRLEN 256
+
+struct _t_datetime_locale {
+  locale_t locale;
+  gchar *codeset;       /* NULL if the locale produces UTF-8 */
+  GIConv converter;     /* from the codeset to UTF-8, opened once */
+  GMutex lock;          /* the converter keeps state between calls */
+};
+
+/* locale name -> t_datetime_locale, or NULL if the locale is not available */
+static GHashTable *locales = NULL;
+G_LOCK_DEFINE_STATIC(locales);
+
+static t_datetime_locale * datetime_locale_new(const gchar *name)
+{
+  t_datetime_locale *locale;
+  locale_t loc = (locale_t) 0;
+  const gchar *codeset;
+  gchar *utf8_name;
+
+  /* prefer the UTF-8 variant, whose strings need no conversion */
+  if (strchr(name, '.') == NULL && strchr(name, '@') == NULL)
+  {
+    utf8_name = g_strconcat(name, ".UTF-8", NULL);
+    loc = newlocale(LC_TIME_MASK | LC_CTYPE_MASK, utf8_name, (locale_t) 0);
+    g_free(utf8_name);
+  }
+
+  if (loc == (locale_t) 0)
+    loc = newlocale(LC_TIME_MASK | LC_CTYPE_MASK, name, (locale_t) 0);
+
+  if (loc == (locale_t) 0)
+    return NULL;
+
+  locale = g_slice_new0(t_datetime_locale);
+  locale->locale = loc;
+
+  codeset = nl_langinfo_l(CODESET, loc);
+  locale->converter = (GIConv) -1;
+  g_mutex_init(&locale->lock);
+  if (g_ascii_strcasecmp(codeset, "UTF-8") != 0 &&
+      g_ascii_strcasecmp(codeset, "utf8") != 0)
+  {
+    locale->codeset = g_strdup(codeset);
+    locale->converter = g_iconv_open("UTF-8", codeset);
+  }
+
+  return locale;
+}
+
+/*
+ * Get a locale by name, e.g. "de_DE".
+ * Locales are created once and kept for the lifetime of the process.
+ * Returns NULL for an empty name or an unavailable locale, which means
+ * the process locale is used.
+ */
+t_datetime_locale * datetime_locale_get(const gchar *name)
+{
+  t_datetime_locale *locale = NULL;
+
+  if (name == NULL || *name == '\0')
+    return NULL;
+
+  G_LOCK(locales);
+
+  if (locales == NULL)
+    locales = g_hash_table_new(g_str_hash, g_str_equal);
+
+  if (!g_hash_table_lookup_extended(locales, name, NULL, (gpointer *) &locale))
+  {
+    locale = datetime_locale_new(name);
+    if (locale == NULL)
+      g_warning("Locale %s is not available", name);
+    g_hash_table_insert(locales, g_strdup(name), locale);
+  }
+
+  G_UNLOCK(locales);
+
+  return locale;
+}
+
+/*
+ * Open a locale of its own for the caller, e.g. for a thread that must not
+ * share the converter with others. Returns NULL like datetime_locale_get().
+ */
+t_datetime_locale * datetime_locale_open(const gchar *name)
+{
+  if (name == NULL || *name == '\0')
+    return NULL;
+
+  return datetime_locale_new(name);
+}
+
+void datetime_locale_close(t_datetime_locale *locale)
+{
+  if (locale == NULL)
+    return;
+
+  if (locale->converter != (GIConv) -1)
+    g_iconv_close(locale->converter);
+  g_mutex_clear(&locale->lock);
+  g_free(locale->codeset);
+  freelocale(locale->locale);
+  g_slice_free(t_datetime_locale, locale);
+}
+
+/*
+ * Format a date/time in the locale as UTF-8 into buf.
+ * Unlike strftime(), this does not depend on the process locale,
+ * so it may be called from any thread.
+ * Returns FALSE if the format or the conversion failed.
+ */
+gboolean datetime_locale_strftime(t_datetime_locale *locale,
+    const gchar *format,
+    const struct tm *tm,
+    gchar *buf,
+    gsize size)
+{
+  gchar raw[LOCALE_MAX_STRLEN];
+  gchar *inbuf = raw;
+  gchar *outbuf = buf;
+  gsize outleft = size - 1;
+  gboolean converted;
+  gsize len;
+
+  if (locale->codeset == NULL)
+  {
+    len = strftime_l(buf, size - 1, format, tm, locale->locale);
+    if (len == 0)
+      return FALSE;
+    buf[len] = '\0';
+    return g_utf8_validate(buf, len, NULL);
+  }
+
+  len = strftime_l(raw, sizeof(raw) - 1, format, tm, locale->locale);
+  if (len == 0)
+    return FALSE;
+  raw[len] = '\0';
+
+  if (locale->converter == (GIConv) -1)
+    return FALSE;
+
+  /* convert straight into buf, resetting the shift state of the last call */
+  g_mutex_lock(&locale->lock);
+  g_iconv(locale->converter, NULL, NULL, NULL, NULL);
+  converted = g_iconv(locale->converter, &inbuf, &len, &outbuf, &outleft) != (gsize) -1;
+  g_mutex_unlock(&locale->lock);
+
+  *outbuf = '\0';
+
+  return converted;
+}
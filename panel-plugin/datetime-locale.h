@@ -0,0 +1,43 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DATETIME_LOCALE_H
+#define _DATETIME_LOCALE_H	1
+
+#include <time.h>
+#include <glib.h>
+
+/* a locale other than the process one, shared by all labels using it */
+typedef struct _t_datetime_locale t_datetime_locale;
+
+t_datetime_locale *
+datetime_locale_get(const gchar *name);
+
+t_datetime_locale *
+datetime_locale_open(const gchar *name);
+
+void
+datetime_locale_close(t_datetime_locale *locale);
+
+gboolean
+datetime_locale_strftime(t_datetime_locale *locale,
+    const gchar *format,
+    const struct tm *tm,
+    gchar *buf,
+    gsize size);
+
+#endif /* datetime-locale.h */
@@ -0,0 +1,279 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* local includes */
+#include <time.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+#include <libxfce4panel/libxfce4panel.h>
+
+#include "datetime-markup.h"
+#include "datetime.h"
+
+/* an attribute of the format, as in the list of either buffer,
+ * with the bounds it starts and ends at */
+typedef struct {
+  PangoAttribute *attr[2];
+  guint start;
+  guint end;
+} t_markup_span;
+
+/*
+ * The format is cut at every byte offset where an attribute starts or ends.
+ * The pieces are formatted one by one, so that the offsets of the bounds in
+ * the rendered string are known without parsing the markup again.
+ */
+struct _t_datetime_markup {
+  gchar *format;          /* the format with the markup stripped */
+  GArray *spans;          /* t_markup_span of every attribute of the format */
+  guint n_bounds;
+  guint *bounds;          /* sorted offsets in format, including 0 and the end */
+  guint *offsets[2];      /* offsets of the bounds in both rendered strings */
+  PangoAttrList *attrs[2];  /* the attributes set with the string of either buffer */
+};
+
+/*
+ * The attributes come in the order of their start, which is kept when they
+ * are moved to the offsets of a rendered string, as those grow with the bounds.
+ */
+static gboolean datetime_markup_collect(PangoAttribute *attr,
+                                        t_datetime_markup *markup)
+{
+  t_markup_span span;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(span.attr); i++)
+  {
+    span.attr[i] = pango_attribute_copy(attr);
+    pango_attr_list_insert(markup->attrs[i], span.attr[i]);
+  }
+  span.start = attr->start_index;
+  span.end = attr->end_index;
+  g_array_append_val(markup->spans, span);
+
+  /* keep the attribute in the template */
+  return FALSE;
+}
+
+static gint datetime_markup_compare_bounds(gconstpointer a, gconstpointer b)
+{
+  guint bound_a = *(const guint *) a;
+  guint bound_b = *(const guint *) b;
+
+  return bound_a < bound_b ? -1 : bound_a > bound_b;
+}
+
+static guint datetime_markup_find_bound(t_datetime_markup *markup, guint offset)
+{
+  guint i;
+
+  for (i = 0; i < markup->n_bounds - 1; i++)
+    if (markup->bounds[i] >= offset)
+      break;
+
+  return i;
+}
+
+/*
+ * Parse the markup of a format.
+ * Returns NULL if the format has no markup or it is not valid,
+ * in which case the format is shown as plain text.
+ */
+t_datetime_markup * datetime_markup_new(const gchar *format)
+{
+  t_datetime_markup *markup;
+  PangoAttrList *template = NULL;
+  gchar *plain = NULL;
+  t_markup_span *span;
+  guint len;
+  guint i, n;
+
+  if (format == NULL || strpbrk(format, "<&") == NULL)
+    return NULL;
+
+  if (!pango_parse_markup(format, -1, 0, &template, &plain, NULL, NULL))
+    return NULL;
+
+  markup = g_slice_new0(t_datetime_markup);
+  markup->format = plain;
+  markup->spans = g_array_new(FALSE, FALSE, sizeof(t_markup_span));
+  markup->attrs[0] = pango_attr_list_new();
+  markup->attrs[1] = pango_attr_list_new();
+  pango_attr_list_filter(template, (PangoAttrFilterFunc) datetime_markup_collect,
+                         markup);
+  pango_attr_list_unref(template);
+
+  /* collect the sorted, distinct offsets where attributes start or end */
+  len = strlen(plain);
+  markup->bounds = g_new(guint, 2 * markup->spans->len + 2);
+  markup->bounds[0] = 0;
+  markup->bounds[1] = len;
+  n = 2;
+  for (i = 0; i < markup->spans->len; i++)
+  {
+    span = &g_array_index(markup->spans, t_markup_span, i);
+    markup->bounds[n++] = MIN(span->start, len);
+    markup->bounds[n++] = MIN(span->end, len);
+  }
+  qsort(markup->bounds, n, sizeof(guint), datetime_markup_compare_bounds);
+  markup->n_bounds = 0;
+  for (i = 0; i < n; i++)
+    if (markup->n_bounds == 0 || markup->bounds[markup->n_bounds - 1] != markup->bounds[i])
+      markup->bounds[markup->n_bounds++] = markup->bounds[i];
+
+  markup->offsets[0] = g_new0(guint, markup->n_bounds);
+  markup->offsets[1] = g_new0(guint, markup->n_bounds);
+
+  /* the spans refer to the bounds, whose offsets change with the text */
+  for (i = 0; i < markup->spans->len; i++)
+  {
+    span = &g_array_index(markup->spans, t_markup_span, i);
+    span->start = datetime_markup_find_bound(markup, span->start);
+    span->end = datetime_markup_find_bound(markup, span->end);
+  }
+
+  return markup;
+}
+
+void datetime_markup_free(t_datetime_markup *markup)
+{
+  if (markup == NULL)
+    return;
+
+  pango_attr_list_unref(markup->attrs[0]);
+  pango_attr_list_unref(markup->attrs[1]);
+  g_array_free(markup->spans, TRUE);
+  g_free(markup->bounds);
+  g_free(markup->offsets[0]);
+  g_free(markup->offsets[1]);
+  g_free(markup->format);
+  g_slice_free(t_datetime_markup, markup);
+}
+
+/*
+ * The format without the markup, e.g. for tooltips
+ */
+const gchar * datetime_markup_get_format(t_datetime_markup *markup)
+{
+  return markup->format;
+}
+
+/*
+ * Render the format in the locale into buf, a buffer of DATETIME_TEXT_SIZE bytes,
+ * and store the offsets of the bounds in offsets, which has room for
+ * datetime_markup_get_n_bounds() of them. The markup is not changed, so
+ * that other threads may render it.
+ * A piece may render empty, e.g. an attribute around %p in a locale without
+ * AM and PM, which leaves its attributes without text.
+ */
+void datetime_markup_render_offsets(const t_datetime_markup *markup,
+    t_datetime_locale *locale,
+    const struct tm *tm,
+    gchar *buf,
+    guint *offsets)
+{
+  gchar piece[DATETIME_MAX_STRLEN];
+  gchar text[DATETIME_TEXT_SIZE];
+  gsize len = 0;
+  gsize size;
+  guint i;
+
+  buf[0] = '\0';
+  offsets[0] = 0;
+  for (i = 1; i < markup->n_bounds; i++)
+  {
+    size = MIN(markup->bounds[i] - markup->bounds[i - 1], sizeof(piece) - 1);
+    memcpy(piece, markup->format + markup->bounds[i - 1], size);
+    piece[size] = '\0';
+
+    if (size > 0 && len < DATETIME_TEXT_SIZE - 1 &&
+        datetime_utf8strftime_l(piece, tm, locale, text, sizeof(text)) > 0)
+      len = MIN(len + g_strlcpy(buf + len, text, DATETIME_TEXT_SIZE - len),
+                DATETIME_TEXT_SIZE - 1);
+    offsets[i] = len;
+  }
+}
+
+/*
+ * Render into buf and remember the offsets of the bounds for the buffer which
+ */
+void datetime_markup_render(t_datetime_markup *markup,
+    t_datetime_locale *locale,
+    const struct tm *tm,
+    gchar *buf,
+    guint which)
+{
+  datetime_markup_render_offsets(markup, locale, tm, buf, markup->offsets[which]);
+}
+
+guint datetime_markup_get_n_bounds(const t_datetime_markup *markup)
+{
+  return markup->n_bounds;
+}
+
+/*
+ * Take over the offsets of a string rendered elsewhere into the buffer which
+ */
+void datetime_markup_set_offsets(t_datetime_markup *markup,
+    guint which,
+    const guint *offsets)
+{
+  memcpy(markup->offsets[which], offsets, markup->n_bounds * sizeof(guint));
+}
+
+/*
+ * Take over the offsets of another buffer whose string was copied
+ */
+void datetime_markup_copy(t_datetime_markup *markup,
+    guint from,
+    guint to)
+{
+  memcpy(markup->offsets[to], markup->offsets[from],
+         markup->n_bounds * sizeof(guint));
+}
+
+/*
+ * Set the attributes at the offsets of the string in buffer which on the
+ * label, after the string was set as its text.
+ * Only the list of that buffer is changed, which the label usually does not
+ * hold; it is given the list again either way, so that it lays the new
+ * string out with the moved attributes.
+ */
+void datetime_markup_apply(t_datetime_markup *markup,
+    GtkLabel *label,
+    guint which)
+{
+  t_markup_span *span;
+  guint i;
+
+  for (i = 0; i < markup->spans->len; i++)
+  {
+    span = &g_array_index(markup->spans, t_markup_span, i);
+    span->attr[which]->start_index = markup->offsets[which][span->start];
+    span->attr[which]->end_index = markup->offsets[which][span->end];
+  }
+
+  gtk_label_set_attributes(label, markup->attrs[which]);
+}
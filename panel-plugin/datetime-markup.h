@@ -0,0 +1,70 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DATETIME_MARKUP_H
+#define _DATETIME_MARKUP_H	1
+
+#include <time.h>
+#include <gtk/gtk.h>
+
+#include "datetime-locale.h"
+
+/* a format with pango markup, parsed once into an attribute template */
+typedef struct _t_datetime_markup t_datetime_markup;
+
+t_datetime_markup *
+datetime_markup_new(const gchar *format);
+
+void
+datetime_markup_free(t_datetime_markup *markup);
+
+const gchar *
+datetime_markup_get_format(t_datetime_markup *markup);
+
+void
+datetime_markup_render(t_datetime_markup *markup,
+    t_datetime_locale *locale,
+    const struct tm *tm,
+    gchar *buf,
+    guint which);
+
+void
+datetime_markup_render_offsets(const t_datetime_markup *markup,
+    t_datetime_locale *locale,
+    const struct tm *tm,
+    gchar *buf,
+    guint *offsets);
+
+guint
+datetime_markup_get_n_bounds(const t_datetime_markup *markup);
+
+void
+datetime_markup_set_offsets(t_datetime_markup *markup,
+    guint which,
+    const guint *offsets);
+
+void
+datetime_markup_copy(t_datetime_markup *markup,
+    guint from,
+    guint to);
+
+void
+datetime_markup_apply(t_datetime_markup *markup,
+    GtkLabel *label,
+    guint which);
+
+#endif /* datetime-markup.h */
@@ -0,0 +1,294 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* local includes */
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#endif
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+#include <glib-unix.h>
+
+#include "datetime-power.h"
+
+#define POWER_SUPPLY_DIR "/sys/class/power_supply"
+
+/* size of the buffer for kernel uevents */
+#define POWER_UEVENT_BUFSIZE 4096
+
+struct _t_power_monitor {
+  gchar *dir;
+  GList *file_monitors;   /* used when dir is not the real sysfs tree */
+  gint uevent_fd;
+  guint uevent_id;
+  gboolean discharging;
+  gint capacity;          /* lowest capacity of discharging batteries, or -1 */
+  t_power_changed_func func;
+  gpointer data;
+};
+
+/*
+ * Read a sysfs attribute of a power supply, without the trailing newline.
+ */
+static gchar * datetime_power_read(t_power_monitor *monitor,
+                                   const gchar *supply,
+                                   const gchar *attribute)
+{
+  gchar *path;
+  gchar *contents = NULL;
+
+  path = g_build_filename(monitor->dir, supply, attribute, NULL);
+  if (g_file_get_contents(path, &contents, NULL, NULL))
+    g_strstrip(contents);
+  g_free(path);
+
+  return contents;
+}
+
+/*
+ * Read the state of all batteries.
+ * Returns TRUE if it changed since the last time.
+ */
+static gboolean datetime_power_refresh(t_power_monitor *monitor)
+{
+  GDir *dir;
+  const gchar *supply;
+  gchar *type, *status, *capacity;
+  gboolean discharging = FALSE;
+  gint lowest = -1;
+  gboolean changed;
+
+  dir = g_dir_open(monitor->dir, 0, NULL);
+  while (dir != NULL && (supply = g_dir_read_name(dir)) != NULL)
+  {
+    type = datetime_power_read(monitor, supply, "type");
+    if (g_strcmp0(type, "Battery") == 0)
+    {
+      status = datetime_power_read(monitor, supply, "status");
+      if (g_strcmp0(status, "Discharging") == 0)
+      {
+        discharging = TRUE;
+        capacity = datetime_power_read(monitor, supply, "capacity");
+        if (capacity != NULL && (lowest < 0 || atoi(capacity) < lowest))
+          lowest = atoi(capacity);
+        g_free(capacity);
+      }
+      g_free(status);
+    }
+    g_free(type);
+  }
+  if (dir != NULL)
+    g_dir_close(dir);
+
+  changed = discharging != monitor->discharging || lowest != monitor->capacity;
+  monitor->discharging = discharging;
+  monitor->capacity = lowest;
+
+  DBG("discharging %d, capacity %d", discharging, lowest);
+
+  return changed;
+}
+
+static void datetime_power_notify(t_power_monitor *monitor)
+{
+  if (datetime_power_refresh(monitor) && monitor->func != NULL)
+    monitor->func(monitor->data);
+}
+
+#ifdef __linux__
+/*
+ * The kernel announces power supply changes with uevents,
+ * since sysfs attributes cannot be watched with inotify.
+ */
+static gboolean datetime_power_uevent(gint fd,
+                                      GIOCondition condition,
+                                      t_power_monitor *monitor)
+{
+  gchar buf[POWER_UEVENT_BUFSIZE];
+  gboolean power_supply = FALSE;
+  gssize len;
+  gssize i;
+
+  while ((len = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT)) > 0)
+  {
+    buf[len] = '\0';
+
+    /* the event is a list of nul separated KEY=value strings */
+    for (i = 0; i < len; i += strlen(buf + i) + 1)
+    {
+      if (strcmp(buf + i, "SUBSYSTEM=power_supply") == 0)
+        power_supply = TRUE;
+    }
+  }
+
+  if (power_supply)
+    datetime_power_notify(monitor);
+
+  return TRUE;
+}
+
+static gboolean datetime_power_watch_uevents(t_power_monitor *monitor)
+{
+  struct sockaddr_nl addr;
+
+  monitor->uevent_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                              NETLINK_KOBJECT_UEVENT);
+  if (monitor->uevent_fd < 0)
+    return FALSE;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = 1;  /* kernel events */
+  if (bind(monitor->uevent_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+  {
+    close(monitor->uevent_fd);
+    monitor->uevent_fd = -1;
+    return FALSE;
+  }
+
+  monitor->uevent_id = g_unix_fd_add(monitor->uevent_fd, G_IO_IN,
+      (GUnixFDSourceFunc) datetime_power_uevent, monitor);
+
+  return TRUE;
+}
+#endif
+
+static void datetime_power_file_changed(GFileMonitor *file_monitor,
+                                        GFile *file,
+                                        GFile *other_file,
+                                        GFileMonitorEvent event_type,
+                                        t_power_monitor *monitor)
+{
+  datetime_power_notify(monitor);
+}
+
+static void datetime_power_watch_file(t_power_monitor *monitor,
+                                      const gchar *path)
+{
+  GFile *file = g_file_new_for_path(path);
+  GFileMonitor *file_monitor;
+
+  file_monitor = g_file_monitor_directory(file, G_FILE_MONITOR_NONE, NULL, NULL);
+  if (file_monitor != NULL)
+  {
+    g_signal_connect(file_monitor, "changed",
+        G_CALLBACK(datetime_power_file_changed), monitor);
+    monitor->file_monitors = g_list_prepend(monitor->file_monitors, file_monitor);
+  }
+  g_object_unref(file);
+}
+
+/*
+ * A tree other than the real sysfs one, e.g. a copy in a temporary directory,
+ * is watched with file monitors on the directory of every supply.
+ */
+static void datetime_power_watch_files(t_power_monitor *monitor)
+{
+  GDir *dir;
+  const gchar *supply;
+  gchar *path;
+
+  datetime_power_watch_file(monitor, monitor->dir);
+
+  dir = g_dir_open(monitor->dir, 0, NULL);
+  while (dir != NULL && (supply = g_dir_read_name(dir)) != NULL)
+  {
+    path = g_build_filename(monitor->dir, supply, NULL);
+    datetime_power_watch_file(monitor, path);
+    g_free(path);
+  }
+  if (dir != NULL)
+    g_dir_close(dir);
+}
+
+/*
+ * Start watching the power supplies.
+ * The DATETIME_POWER_SUPPLY_DIR environment variable overrides the sysfs
+ * directory, so that the throttling can be tried with a fake tree.
+ */
+t_power_monitor * datetime_power_monitor_new(t_power_changed_func func,
+                                             gpointer data)
+{
+  t_power_monitor *monitor = g_slice_new0(t_power_monitor);
+  const gchar *dir = g_getenv("DATETIME_POWER_SUPPLY_DIR");
+
+  monitor->dir = g_strdup(dir != NULL ? dir : POWER_SUPPLY_DIR);
+  monitor->uevent_fd = -1;
+  monitor->capacity = -1;
+  monitor->func = func;
+  monitor->data = data;
+
+  datetime_power_refresh(monitor);
+
+#ifdef __linux__
+  if (dir == NULL && datetime_power_watch_uevents(monitor))
+    return monitor;
+#endif
+
+  datetime_power_watch_files(monitor);
+
+  return monitor;
+}
+
+void datetime_power_monitor_free(t_power_monitor *monitor)
+{
+  if (monitor->uevent_id != 0)
+    g_source_remove(monitor->uevent_id);
+  if (monitor->uevent_fd >= 0)
+    close(monitor->uevent_fd);
+  g_list_free_full(monitor->file_monitors, g_object_unref);
+  g_free(monitor->dir);
+  g_slice_free(t_power_monitor, monitor);
+}
+
+/*
+ * Whether the system runs on a discharging battery.
+ * capacity is set to the lowest charge in percent, or -1 if unknown.
+ */
+gboolean datetime_power_monitor_discharging(t_power_monitor *monitor,
+                                            gint *capacity)
+{
+  *capacity = monitor->capacity;
+
+  return monitor->discharging;
+}
+
+/*
+ * Whether updates should slow down: the system runs on a discharging battery
+ * charged to at most threshold percent. A threshold of 0 never throttles,
+ * and an unknown capacity counts as low.
+ */
+gboolean datetime_power_monitor_throttles(t_power_monitor *monitor,
+                                          guint threshold)
+{
+  gint capacity;
+
+  if (threshold == 0 || !datetime_power_monitor_discharging(monitor, &capacity))
+    return FALSE;
+
+  return capacity < 0 || (guint) capacity <= threshold;
+}
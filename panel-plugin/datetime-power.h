@@ -0,0 +1,43 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DATETIME_POWER_H
+#define _DATETIME_POWER_H	1
+
+#include <glib.h>
+
+/* watches the batteries under /sys/class/power_supply */
+typedef struct _t_power_monitor t_power_monitor;
+
+typedef void (*t_power_changed_func)(gpointer data);
+
+t_power_monitor *
+datetime_power_monitor_new(t_power_changed_func func,
+    gpointer data);
+
+void
+datetime_power_monitor_free(t_power_monitor *monitor);
+
+gboolean
+datetime_power_monitor_discharging(t_power_monitor *monitor,
+    gint *capacity);
+
+gboolean
+datetime_power_monitor_throttles(t_power_monitor *monitor,
+    guint threshold);
+
+#endif /* datetime-power.h */
@@ -0,0 +1,374 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* local includes */
+#include <string.h>
+#include <math.h>
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "datetime-rotated.h"
+
+/* positions of a glyph within a pixel which get their own mask */
+#define ROTATED_PHASES 4
+
+/*
+ * A glyph of a font rendered once, at one of the subpixel phases and rotated
+ * clockwise by 90 degrees, into an alpha mask covering its ink.
+ * The mask is painted with the text color, so color changes need no rerender.
+ */
+typedef struct {
+  PangoFont *font;
+  PangoGlyph glyph;
+  gint phase;
+  cairo_surface_t *mask;
+  gint left;        /* ink box of the unrotated glyph relative to its origin */
+  gint top;         /* in whole pixels, the phase included */
+  gint width;
+  gint height;
+} t_rotated_glyph;
+
+/* a glyph of the shaped text with the offset of its mask in the line */
+typedef struct {
+  t_rotated_glyph *glyph;
+  gint x;
+  gint y;
+} t_placed_glyph;
+
+struct _t_rotated_line {
+  gchar *font;
+  gint scale;
+  PangoLayout *layout;      /* shapes the text, reused */
+  PangoGlyphString *single; /* a run of one glyph, to render a mask */
+  GHashTable *glyphs;       /* t_rotated_glyph -> itself */
+  GArray *placed;           /* t_placed_glyph of the text */
+  GArray *previous;         /* t_placed_glyph of the text before */
+  GString *text;            /* reused, so that setting text does not allocate */
+  gboolean text_valid;
+  gint thickness;
+  gint length;
+};
+
+static guint datetime_rotated_glyph_hash(gconstpointer key)
+{
+  const t_rotated_glyph *glyph = key;
+
+  return g_direct_hash(glyph->font) ^ (glyph->glyph * ROTATED_PHASES + glyph->phase);
+}
+
+static gboolean datetime_rotated_glyph_equal(gconstpointer a, gconstpointer b)
+{
+  const t_rotated_glyph *glyph_a = a;
+  const t_rotated_glyph *glyph_b = b;
+
+  return glyph_a->font == glyph_b->font && glyph_a->glyph == glyph_b->glyph &&
+         glyph_a->phase == glyph_b->phase;
+}
+
+static void datetime_rotated_glyph_free(t_rotated_glyph *glyph)
+{
+  g_object_unref(glyph->font);
+  cairo_surface_destroy(glyph->mask);
+  g_slice_free(t_rotated_glyph, glyph);
+}
+
+t_rotated_line * datetime_rotated_line_new(void)
+{
+  t_rotated_line *line = g_slice_new0(t_rotated_line);
+
+  line->glyphs = g_hash_table_new_full(datetime_rotated_glyph_hash,
+      datetime_rotated_glyph_equal,
+      (GDestroyNotify) datetime_rotated_glyph_free, NULL);
+  line->placed = g_array_new(FALSE, FALSE, sizeof(t_placed_glyph));
+  line->previous = g_array_new(FALSE, FALSE, sizeof(t_placed_glyph));
+  line->single = pango_glyph_string_new();
+  pango_glyph_string_set_size(line->single, 1);
+  line->text = g_string_new(NULL);
+
+  return line;
+}
+
+void datetime_rotated_line_free(t_rotated_line *line)
+{
+  g_hash_table_destroy(line->glyphs);
+  g_array_free(line->placed, TRUE);
+  g_array_free(line->previous, TRUE);
+  pango_glyph_string_free(line->single);
+  if (line->layout != NULL)
+    g_object_unref(line->layout);
+  g_free(line->font);
+  g_string_free(line->text, TRUE);
+  g_slice_free(t_rotated_line, line);
+}
+
+/*
+ * Drop all cached glyphs and the layout, e.g. when the font options of the
+ * screen changed.
+ */
+void datetime_rotated_line_flush(t_rotated_line *line)
+{
+  g_array_set_size(line->placed, 0);
+  g_array_set_size(line->previous, 0);
+  g_hash_table_remove_all(line->glyphs);
+  g_clear_object(&line->layout);
+  line->text_valid = FALSE;
+}
+
+/*
+ * The text is shaped as a single line, so it must not break.
+ */
+gboolean datetime_rotated_text_supported(const gchar *text)
+{
+  return text == NULL || strchr(text, '\n') == NULL;
+}
+
+static t_rotated_glyph * datetime_rotated_glyph_new(t_rotated_line *line,
+    PangoFont *font,
+    PangoGlyph id,
+    gint phase)
+{
+  t_rotated_glyph *glyph;
+  PangoRectangle ink;
+  gdouble offset = (gdouble) phase / ROTATED_PHASES;
+  cairo_t *cr;
+
+  pango_font_get_glyph_extents(font, id, &ink, NULL);
+
+  /* the mask covers the ink with a pixel to spare for antialiasing */
+  glyph = g_slice_new0(t_rotated_glyph);
+  glyph->font = g_object_ref(font);
+  glyph->glyph = id;
+  glyph->phase = phase;
+  glyph->left = (gint) floor(offset + (gdouble) ink.x / PANGO_SCALE) - 1;
+  glyph->top = (gint) floor((gdouble) ink.y / PANGO_SCALE) - 1;
+  glyph->width = (gint) ceil(offset + (gdouble) (ink.x + ink.width) / PANGO_SCALE) +
+                 1 - glyph->left;
+  glyph->height = (gint) ceil((gdouble) (ink.y + ink.height) / PANGO_SCALE) +
+                  1 - glyph->top;
+
+  /* the rotated glyph is as wide as its ink is high */
+  glyph->mask = cairo_image_surface_create(CAIRO_FORMAT_A8,
+                                           glyph->height * line->scale,
+                                           glyph->width * line->scale);
+  cairo_surface_set_device_scale(glyph->mask, line->scale, line->scale);
+
+  line->single->glyphs[0].glyph = id;
+  line->single->glyphs[0].geometry.width = 0;
+  line->single->glyphs[0].geometry.x_offset = 0;
+  line->single->glyphs[0].geometry.y_offset = 0;
+  line->single->glyphs[0].attr.is_cluster_start = 1;
+  line->single->log_clusters[0] = 0;
+
+  cr = cairo_create(glyph->mask);
+  cairo_translate(cr, glyph->height, 0);
+  cairo_rotate(cr, G_PI / 2);
+  cairo_translate(cr, -glyph->left, -glyph->top);
+  cairo_move_to(cr, offset, 0);
+  pango_cairo_show_glyph_string(cr, font, line->single);
+  cairo_destroy(cr);
+
+  return glyph;
+}
+
+static t_rotated_glyph * datetime_rotated_glyph_get(t_rotated_line *line,
+    PangoFont *font,
+    PangoGlyph id,
+    gint phase)
+{
+  t_rotated_glyph key = { font, id, phase };
+  t_rotated_glyph *glyph = g_hash_table_lookup(line->glyphs, &key);
+
+  if (glyph == NULL)
+  {
+    glyph = datetime_rotated_glyph_new(line, font, id, phase);
+    g_hash_table_add(line->glyphs, glyph);
+  }
+
+  return glyph;
+}
+
+/*
+ * Place the glyphs of the shaped text top to bottom.
+ * A glyph is positioned to a quarter pixel along the line, by the mask of its
+ * phase, and the mask itself is painted at whole pixels.
+ */
+static void datetime_rotated_line_place(t_rotated_line *line)
+{
+  PangoLayoutLine *layout_line;
+  PangoGlyphItem *run;
+  PangoGlyphInfo *info;
+  PangoRectangle logical;
+  t_placed_glyph placed;
+  GSList *runs;
+  gint pen, baseline, position, phase, i;
+
+  g_array_set_size(line->placed, 0);
+
+  pango_layout_get_pixel_extents(line->layout, NULL, &logical);
+  line->thickness = logical.height;
+  line->length = logical.width;
+  baseline = PANGO_PIXELS(pango_layout_get_baseline(line->layout)) - logical.y;
+
+  layout_line = pango_layout_get_line_readonly(line->layout, 0);
+  if (layout_line == NULL)
+    return;
+
+  pango_layout_line_get_extents(layout_line, NULL, &logical);
+  pen = logical.x;
+  for (runs = layout_line->runs; runs != NULL; runs = runs->next)
+  {
+    run = runs->data;
+    for (i = 0; i < run->glyphs->num_glyphs; i++)
+    {
+      info = &run->glyphs->glyphs[i];
+      if (info->glyph != PANGO_GLYPH_EMPTY)
+      {
+        /* quarter pixels from the start of the line */
+        position = PANGO_UNITS_ROUND((pen + info->geometry.x_offset) * ROTATED_PHASES) /
+                   PANGO_SCALE;
+        phase = ((position % ROTATED_PHASES) + ROTATED_PHASES) % ROTATED_PHASES;
+        placed.glyph = datetime_rotated_glyph_get(line, run->item->analysis.font,
+            info->glyph, phase);
+
+        /* the text runs down, its top edge is at the right of the line */
+        placed.y = (position - phase) / ROTATED_PHASES + placed.glyph->left;
+        placed.x = line->thickness - baseline -
+                   PANGO_PIXELS(info->geometry.y_offset) -
+                   placed.glyph->top - placed.glyph->height;
+        g_array_append_val(line->placed, placed);
+      }
+      pen += info->geometry.width;
+    }
+  }
+}
+
+/*
+ * Set the text of the line, rendering only glyphs which are not cached yet.
+ * changed_from is set to the offset in pixels from which the line looks
+ * different, or -1 if nothing changed.
+ * Returns TRUE if the size of the line changed.
+ */
+gboolean datetime_rotated_line_set_text(t_rotated_line *line,
+    GtkWidget *widget,
+    const gchar *font,
+    const gchar *text,
+    gint *changed_from)
+{
+  PangoFontDescription *desc;
+  t_placed_glyph *placed, *previous;
+  GArray *swap;
+  gint scale = gtk_widget_get_scale_factor(widget);
+  gint old_thickness = line->thickness;
+  gint old_length = line->length;
+  guint i, first;
+
+  if (text == NULL)
+    text = "";
+
+  /* glyphs are rasterized once per font and scale */
+  if (line->scale != scale || g_strcmp0(line->font, font) != 0)
+  {
+    datetime_rotated_line_flush(line);
+    g_free(line->font);
+    line->font = g_strdup(font);
+    line->scale = scale;
+  }
+
+  if (line->text_valid && strcmp(line->text->str, text) == 0)
+  {
+    *changed_from = -1;
+    return FALSE;
+  }
+
+  if (line->layout == NULL)
+  {
+    line->layout = gtk_widget_create_pango_layout(widget, NULL);
+    desc = pango_font_description_from_string(line->font != NULL ? line->font : "");
+    pango_layout_set_font_description(line->layout, desc);
+    pango_font_description_free(desc);
+  }
+
+  swap = line->previous;
+  line->previous = line->placed;
+  line->placed = swap;
+
+  pango_layout_set_text(line->layout, text, -1);
+  datetime_rotated_line_place(line);
+
+  g_string_assign(line->text, text);
+  line->text_valid = TRUE;
+
+  /* the glyphs up to the first difference look the same */
+  for (first = 0; first < line->placed->len && first < line->previous->len; first++)
+  {
+    placed = &g_array_index(line->placed, t_placed_glyph, first);
+    previous = &g_array_index(line->previous, t_placed_glyph, first);
+    if (placed->glyph != previous->glyph ||
+        placed->x != previous->x || placed->y != previous->y)
+      break;
+  }
+
+  /* the ink of the glyphs drawn from there may reach back, and so may that
+   * of the glyphs they replace */
+  *changed_from = line->length;
+  for (i = first; i < line->placed->len; i++)
+    *changed_from = MIN(*changed_from,
+                        g_array_index(line->placed, t_placed_glyph, i).y);
+  for (i = first; i < line->previous->len; i++)
+    *changed_from = MIN(*changed_from,
+                        g_array_index(line->previous, t_placed_glyph, i).y);
+  *changed_from = MAX(*changed_from, 0);
+
+  return line->length != old_length || line->thickness != old_thickness;
+}
+
+void datetime_rotated_line_get_size(t_rotated_line *line,
+    gint *thickness,
+    gint *length)
+{
+  *thickness = line->thickness;
+  *length = line->length;
+}
+
+/*
+ * Paint the line top to bottom, with (x, y) as its top left corner.
+ */
+void datetime_rotated_line_draw(t_rotated_line *line,
+    cairo_t *cr,
+    gdouble x,
+    gdouble y,
+    const GdkRGBA *color)
+{
+  t_placed_glyph *placed;
+  guint i;
+
+  if (!line->text_valid)
+    return;
+
+  gdk_cairo_set_source_rgba(cr, color);
+  for (i = 0; i < line->placed->len; i++)
+  {
+    placed = &g_array_index(line->placed, t_placed_glyph, i);
+    cairo_mask_surface(cr, placed->glyph->mask, x + placed->x, y + placed->y);
+  }
+}
@@ -0,0 +1,57 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DATETIME_ROTATED_H
+#define _DATETIME_ROTATED_H	1
+
+#include <gtk/gtk.h>
+
+/* a line of text drawn top to bottom from cached, pre-rotated glyphs */
+typedef struct _t_rotated_line t_rotated_line;
+
+t_rotated_line *
+datetime_rotated_line_new(void);
+
+void
+datetime_rotated_line_free(t_rotated_line *line);
+
+gboolean
+datetime_rotated_text_supported(const gchar *text);
+
+gboolean
+datetime_rotated_line_set_text(t_rotated_line *line,
+    GtkWidget *widget,
+    const gchar *font,
+    const gchar *text,
+    gint *changed_from);
+
+void
+datetime_rotated_line_get_size(t_rotated_line *line,
+    gint *thickness,
+    gint *length);
+
+void
+datetime_rotated_line_draw(t_rotated_line *line,
+    cairo_t *cr,
+    gdouble x,
+    gdouble y,
+    const GdkRGBA *color);
+
+void
+datetime_rotated_line_flush(t_rotated_line *line);
+
+#endif /* datetime-rotated.h */
@@ -0,0 +1,148 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "datetime-snapshot.h"
+
+/* group of the snapshot file, changed with its format */
+#define SNAPSHOT_GROUP "render 1"
+
+static gchar * datetime_snapshot_file(const gchar *name)
+{
+  gchar *file_name = g_strconcat(name, ".snapshot", NULL);
+  gchar *file;
+
+  file = g_build_filename(g_get_user_cache_dir(), "xfce4", "datetime-plugin",
+                          file_name, NULL);
+  g_free(file_name);
+
+  return file;
+}
+
+/*
+ * Read the snapshot of a plugin, which is named after its id.
+ * Returns NULL unless there is one for the settings hashed into config.
+ */
+t_render_snapshot * datetime_snapshot_load(const gchar *name,
+                                           const gchar *config)
+{
+  t_render_snapshot *snapshot = NULL;
+  GKeyFile *key_file = g_key_file_new();
+  gchar *file = datetime_snapshot_file(name);
+  gchar *saved_config;
+  gint row_size;
+
+  if (g_key_file_load_from_file(key_file, file, G_KEY_FILE_NONE, NULL))
+  {
+    saved_config = g_key_file_get_string(key_file, SNAPSHOT_GROUP, "config", NULL);
+    row_size = g_key_file_get_integer(key_file, SNAPSHOT_GROUP, "row_size", NULL);
+    if (g_strcmp0(saved_config, config) == 0 && row_size > 0)
+    {
+      snapshot = g_slice_new0(t_render_snapshot);
+      snapshot->config = g_strdup(config);
+      snapshot->row_size = row_size;
+      snapshot->date_font = g_key_file_get_string(key_file, SNAPSHOT_GROUP,
+                                                  "date_font", NULL);
+      snapshot->time_font = g_key_file_get_string(key_file, SNAPSHOT_GROUP,
+                                                  "time_font", NULL);
+    }
+    g_free(saved_config);
+  }
+
+  DBG("snapshot %s: %s", file, snapshot != NULL ? "hit" : "miss");
+
+  g_key_file_free(key_file);
+  g_free(file);
+
+  return snapshot;
+}
+
+static void datetime_snapshot_saved(GFile *file,
+                                    GAsyncResult *result,
+                                    gpointer data)
+{
+  /* the snapshot is only an optimization, so errors are ignored */
+  g_file_replace_contents_finish(file, result, NULL, NULL);
+}
+
+/*
+ * Write the snapshot of a plugin without blocking the main loop
+ */
+void datetime_snapshot_save(const gchar *name,
+                            const t_render_snapshot *snapshot)
+{
+  GKeyFile *key_file = g_key_file_new();
+  gchar *path = datetime_snapshot_file(name);
+  gchar *dir = g_path_get_dirname(path);
+  gchar *contents;
+  gsize len;
+  GBytes *bytes;
+  GFile *file;
+
+  g_key_file_set_string(key_file, SNAPSHOT_GROUP, "config", snapshot->config);
+  g_key_file_set_integer(key_file, SNAPSHOT_GROUP, "row_size", snapshot->row_size);
+  if (snapshot->date_font != NULL)
+    g_key_file_set_string(key_file, SNAPSHOT_GROUP, "date_font", snapshot->date_font);
+  if (snapshot->time_font != NULL)
+    g_key_file_set_string(key_file, SNAPSHOT_GROUP, "time_font", snapshot->time_font);
+  contents = g_key_file_to_data(key_file, &len, NULL);
+  bytes = g_bytes_new_take(contents, len);
+
+  if (g_mkdir_with_parents(dir, 0700) == 0)
+  {
+    file = g_file_new_for_path(path);
+    g_file_replace_contents_bytes_async(file, bytes, NULL, FALSE,
+        G_FILE_CREATE_PRIVATE, NULL,
+        (GAsyncReadyCallback) datetime_snapshot_saved, NULL);
+    g_object_unref(file);
+  }
+
+  g_bytes_unref(bytes);
+  g_key_file_free(key_file);
+  g_free(dir);
+  g_free(path);
+}
+
+gboolean datetime_snapshot_equal(const t_render_snapshot *a,
+                                 const t_render_snapshot *b)
+{
+  if (a == NULL || b == NULL)
+    return a == b;
+
+  return g_strcmp0(a->config, b->config) == 0 &&
+         a->row_size == b->row_size &&
+         g_strcmp0(a->date_font, b->date_font) == 0 &&
+         g_strcmp0(a->time_font, b->time_font) == 0;
+}
+
+void datetime_snapshot_free(t_render_snapshot *snapshot)
+{
+  if (snapshot == NULL)
+    return;
+
+  g_free(snapshot->config);
+  g_free(snapshot->date_font);
+  g_free(snapshot->time_font);
+  g_slice_free(t_render_snapshot, snapshot);
+}
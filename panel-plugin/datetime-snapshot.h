@@ -0,0 +1,47 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _DATETIME_SNAPSHOT_H
+#define _DATETIME_SNAPSHOT_H	1
+
+#include <glib.h>
+
+/* the layout of the last run, for the first layout of the next one */
+typedef struct {
+  gchar *config;      /* hash of the settings the layout was computed for */
+  gint row_size;      /* pixels available for the lines */
+  gchar *date_font;   /* fonts fitted to the row, or NULL */
+  gchar *time_font;
+} t_render_snapshot;
+
+t_render_snapshot *
+datetime_snapshot_load(const gchar *name,
+    const gchar *config);
+
+void
+datetime_snapshot_save(const gchar *name,
+    const t_render_snapshot *snapshot);
+
+gboolean
+datetime_snapshot_equal(const t_render_snapshot *a,
+    const t_render_snapshot *b);
+
+void
+datetime_snapshot_free(t_render_snapshot *snapshot);
+
+#endif /* datetime-snapshot.h */
@@ -0,0 +1,225 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* local includes */
+#include <time.h>
+#include <string.h>
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+#include <libxfce4panel/libxfce4panel.h>
+
+#include "datetime-table.h"
+#include "datetime.h"
+
+#define MINUTES_PER_DAY (24 * 60)
+
+typedef enum {
+  TABLE_MINUTE_OF_DAY,  /* the format only shows the time of day */
+  TABLE_DAY_OF_YEAR     /* the format only shows the date */
+} t_table_kind;
+
+/*
+ * All strings are stored once, one after another, in a single block.
+ * Equal strings, e.g. the same weekday of different weeks, are shared.
+ */
+struct _t_string_table {
+  t_table_kind kind;
+  gint year;            /* year of a day-of-year table */
+  guint n_entries;
+  guint32 *offsets;     /* offset of each entry's string in strings */
+  gchar *strings;
+  gsize size;           /* bytes of strings */
+};
+
+/*
+ * Find out which fields of the time a format shows, from the fields the
+ * compiled format depends on. The zone may change with either the time of
+ * day or the date, e.g. for daylight saving time.
+ * Returns FALSE if the format shows both, seconds, or things like '%s'.
+ */
+static gboolean datetime_table_kind(const t_datetime_format *format, t_table_kind *kind)
+{
+  guint fields = datetime_format_get_fields(format);
+
+  if ((fields & ~(DATETIME_FIELD_MINUTES | DATETIME_FIELD_HOURS)) == 0)
+  {
+    *kind = TABLE_MINUTE_OF_DAY;
+    return TRUE;
+  }
+
+  if ((fields & ~DATETIME_FIELD_DATE) == 0)
+  {
+    *kind = TABLE_DAY_OF_YEAR;
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+static void datetime_table_add(t_string_table *table,
+                               GString *strings,
+                               GHashTable *interned,
+                               guint entry,
+                               const gchar *text)
+{
+  gpointer offset;
+
+  if (!g_hash_table_lookup_extended(interned, text, NULL, &offset))
+  {
+    offset = GUINT_TO_POINTER(strings->len);
+    g_string_append_len(strings, text, strlen(text) + 1);
+    g_hash_table_insert(interned, g_strdup(text), offset);
+  }
+
+  table->offsets[entry] = GPOINTER_TO_UINT(offset);
+}
+
+/*
+ * Format all minutes of a day, or all days of the year of tm, in the locale.
+ * The days are those of the time zone tz, or of the local one if it is NULL.
+ * Returns NULL if the format depends on more than one of them.
+ */
+t_string_table * datetime_string_table_new(const gchar *format,
+    t_datetime_locale *locale,
+    GTimeZone *tz,
+    const struct tm *tm)
+{
+  t_string_table *table;
+  t_table_kind kind;
+  t_datetime_format *compiled;
+  GString *strings;
+  GHashTable *interned;
+  gchar *texts;
+  struct tm entry_tms[DATETIME_FORMAT_BATCH];
+  gint64 stamps[DATETIME_FORMAT_BATCH];
+  GDateTime *noon_time;
+  gint64 noon;
+  guint i, j, count;
+
+  if (format == NULL)
+    return NULL;
+
+  compiled = datetime_format_new(format);
+  if (!datetime_table_kind(compiled, &kind))
+  {
+    datetime_format_free(compiled);
+    return NULL;
+  }
+
+  table = g_slice_new0(t_string_table);
+  table->kind = kind;
+  table->year = tm->tm_year;
+  strings = g_string_new(NULL);
+  interned = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  texts = g_malloc(DATETIME_FORMAT_BATCH * DATETIME_TEXT_SIZE);
+
+  if (kind == TABLE_MINUTE_OF_DAY)
+  {
+    table->n_entries = MINUTES_PER_DAY;
+    table->offsets = g_new(guint32, table->n_entries);
+    for (i = 0; i < table->n_entries; i += count)
+    {
+      count = MIN(table->n_entries - i, DATETIME_FORMAT_BATCH);
+      for (j = 0; j < count; j++)
+      {
+        entry_tms[j] = *tm;
+        entry_tms[j].tm_hour = (i + j) / 60;
+        entry_tms[j].tm_min = (i + j) % 60;
+        entry_tms[j].tm_sec = 0;
+      }
+      datetime_format_render_batch(compiled, locale, entry_tms, count,
+                                   texts, DATETIME_TEXT_SIZE);
+      for (j = 0; j < count; j++)
+        datetime_table_add(table, strings, interned, i + j,
+                           texts + j * DATETIME_TEXT_SIZE);
+    }
+  }
+  else
+  {
+    /* noon of every day, which daylight saving time never moves to another day */
+    table->n_entries = g_date_get_days_in_year(tm->tm_year + 1900);
+    table->offsets = g_new(guint32, table->n_entries);
+    if (tz != NULL)
+      noon_time = g_date_time_new(tz, tm->tm_year + 1900, 1, 1, 12, 0, 0);
+    else
+      noon_time = g_date_time_new_local(tm->tm_year + 1900, 1, 1, 12, 0, 0);
+    noon = g_date_time_to_unix(noon_time);
+    g_date_time_unref(noon_time);
+    for (i = 0; i < table->n_entries; i += count)
+    {
+      count = MIN(table->n_entries - i, DATETIME_FORMAT_BATCH);
+      for (j = 0; j < count; j++)
+        stamps[j] = noon + (gint64) (i + j) * 24 * 60 * 60;
+      datetime_format_render_stamps(compiled, locale, tz, stamps, count,
+                                    texts, DATETIME_TEXT_SIZE);
+      for (j = 0; j < count; j++)
+        datetime_table_add(table, strings, interned, i + j,
+                           texts + j * DATETIME_TEXT_SIZE);
+    }
+  }
+
+  g_free(texts);
+  datetime_format_free(compiled);
+
+  table->size = strings->len;
+  table->strings = g_string_free(strings, FALSE);
+
+  DBG("%s table of \"%s\": %u entries, %u distinct strings, %" G_GSIZE_FORMAT " bytes",
+      kind == TABLE_MINUTE_OF_DAY ? "minute-of-day" : "day-of-year", format,
+      table->n_entries, g_hash_table_size(interned),
+      table->size + table->n_entries * sizeof(guint32));
+  g_hash_table_destroy(interned);
+
+  return table;
+}
+
+void datetime_string_table_free(t_string_table *table)
+{
+  if (table == NULL)
+    return;
+
+  g_free(table->offsets);
+  g_free(table->strings);
+  g_slice_free(t_string_table, table);
+}
+
+/*
+ * Get the string for tm, or NULL if the table was built for another year.
+ */
+const gchar * datetime_string_table_lookup(t_string_table *table,
+    const struct tm *tm)
+{
+  guint entry;
+
+  if (table->kind == TABLE_MINUTE_OF_DAY)
+    entry = tm->tm_hour * 60 + tm->tm_min;
+  else if (table->year == tm->tm_year)
+    entry = tm->tm_yday;
+  else
+    return NULL;
+
+  if (entry >= table->n_entries)
+    return NULL;
+
+  return table->strings + table->offsets[entry];
+}
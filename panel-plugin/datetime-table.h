@@ -0,0 +1,42 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DATETIME_TABLE_H
+#define _DATETIME_TABLE_H	1
+
+#include <time.h>
+#include <glib.h>
+
+#include "datetime-locale.h"
+
+/* every string a format gives for the minutes of a day or the days of a year */
+typedef struct _t_string_table t_string_table;
+
+t_string_table *
+datetime_string_table_new(const gchar *format,
+    t_datetime_locale *locale,
+    GTimeZone *tz,
+    const struct tm *tm);
+
+void
+datetime_string_table_free(t_string_table *table);
+
+const gchar *
+datetime_string_table_lookup(t_string_table *table,
+    const struct tm *tm);
+
+#endif /* datetime-table.h */
@@ -0,0 +1,49 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DATETIME_TRACE_H
+#define _DATETIME_TRACE_H	1
+
+/*
+ * Marks around the hot paths, shown by sysprof when built with
+ * --enable-sysprof. Without it, these compile to nothing.
+ */
+
+#include <glib.h>
+
+#ifdef HAVE_SYSPROF
+#include <sysprof-capture.h>
+#endif
+
+static inline gint64 datetime_trace_begin(void)
+{
+#ifdef HAVE_SYSPROF
+  return SYSPROF_CAPTURE_CURRENT_TIME;
+#else
+  return 0;
+#endif
+}
+
+static inline void datetime_trace_end(gint64 begin_time, const gchar *name)
+{
+#ifdef HAVE_SYSPROF
+  sysprof_collector_mark(begin_time, SYSPROF_CAPTURE_CURRENT_TIME - begin_time,
+                         "datetime", name, NULL);
+#endif
+}
+
+#endif /* datetime-trace.h */
@@ -0,0 +1,215 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "datetime-worker.h"
+
+/*
+ * Frames are handed to the main thread through a single slot, which is only
+ * accessed with atomic operations: posting replaces the frame in it, taking
+ * empties it. Neither side ever waits for the other.
+ */
+struct _t_render_worker {
+  GThread *thread;
+  GMainContext *context;
+  GMainLoop *loop;
+  GSource *render_source;     /* calls func when armed */
+  GSource *watchdog_source;   /* checks that the posted frame was taken */
+  gpointer slot;              /* the posted frame, or NULL */
+  gpointer watched;           /* frame the watchdog waits for */
+  gint64 watched_due;
+  GDestroyNotify frame_free;
+};
+
+static gboolean datetime_worker_dispatch(GSource *source,
+                                         GSourceFunc callback,
+                                         gpointer data)
+{
+  g_source_set_ready_time(source, -1);
+  callback(data);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs datetime_worker_funcs = {
+  NULL, NULL, datetime_worker_dispatch, NULL
+};
+
+static GSource * datetime_worker_source_new(t_render_worker *worker,
+                                            GSourceFunc func,
+                                            gpointer data)
+{
+  GSource *source = g_source_new(&datetime_worker_funcs, sizeof(GSource));
+
+  g_source_set_callback(source, func, data, NULL);
+  g_source_attach(source, worker->context);
+
+  return source;
+}
+
+/*
+ * Swap the pointer in slot for value and return the old one.
+ * g_atomic_pointer_exchange() would need GLib 2.74.
+ */
+gpointer datetime_worker_swap(gpointer *slot, gpointer value)
+{
+  gpointer old;
+
+  do
+    old = g_atomic_pointer_get(slot);
+  while (!g_atomic_pointer_compare_and_exchange(slot, old, value));
+
+  return old;
+}
+
+static gpointer datetime_worker_exchange(t_render_worker *worker, gpointer frame)
+{
+  return datetime_worker_swap(&worker->slot, frame);
+}
+
+/*
+ * The main thread has not taken the frame by the time it was due,
+ * so the panel shows an old time until its main loop runs again.
+ */
+static gboolean datetime_worker_watchdog(t_render_worker *worker)
+{
+  if (worker->watched != NULL && g_atomic_pointer_get(&worker->slot) == worker->watched)
+    g_message("The main loop is stalled, the clock has not been updated for %"
+              G_GINT64_FORMAT " ms",
+              (g_get_monotonic_time() - worker->watched_due) / 1000);
+  worker->watched = NULL;
+
+  return G_SOURCE_CONTINUE;
+}
+
+/*
+ * Quit from the worker's own loop: a quit from another thread before the
+ * loop runs would be lost, as g_main_loop_run() starts it anew.
+ */
+static gboolean datetime_worker_quit(t_render_worker *worker)
+{
+  g_main_loop_quit(worker->loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gpointer datetime_worker_run(t_render_worker *worker)
+{
+  g_main_context_push_thread_default(worker->context);
+  g_main_loop_run(worker->loop);
+  g_main_context_pop_thread_default(worker->context);
+
+  return NULL;
+}
+
+/*
+ * Start a worker thread which calls func whenever it is armed.
+ * func runs on the worker thread; frame_free frees frames nobody took.
+ */
+t_render_worker * datetime_worker_new(GSourceFunc func,
+                                      gpointer data,
+                                      GDestroyNotify frame_free)
+{
+  t_render_worker *worker = g_slice_new0(t_render_worker);
+
+  worker->frame_free = frame_free;
+  worker->context = g_main_context_new();
+  worker->loop = g_main_loop_new(worker->context, FALSE);
+  worker->render_source = datetime_worker_source_new(worker, func, data);
+  worker->watchdog_source = datetime_worker_source_new(worker,
+      (GSourceFunc) datetime_worker_watchdog, worker);
+  worker->thread = g_thread_new("datetime-render",
+                                (GThreadFunc) datetime_worker_run, worker);
+
+  return worker;
+}
+
+void datetime_worker_free(t_render_worker *worker)
+{
+  GSource *quit_source;
+  gpointer frame;
+
+  quit_source = g_idle_source_new();
+  g_source_set_callback(quit_source, (GSourceFunc) datetime_worker_quit,
+                        worker, NULL);
+  g_source_attach(quit_source, worker->context);
+  g_source_unref(quit_source);
+  g_thread_join(worker->thread);
+
+  g_source_destroy(worker->render_source);
+  g_source_unref(worker->render_source);
+  g_source_destroy(worker->watchdog_source);
+  g_source_unref(worker->watchdog_source);
+  g_main_loop_unref(worker->loop);
+  g_main_context_unref(worker->context);
+
+  frame = datetime_worker_exchange(worker, NULL);
+  if (frame != NULL)
+    worker->frame_free(frame);
+
+  g_slice_free(t_render_worker, worker);
+}
+
+/*
+ * Call func at the given monotonic time, or never if it is -1.
+ * May be called from any thread.
+ */
+void datetime_worker_arm(t_render_worker *worker, gint64 ready_time)
+{
+  g_source_set_ready_time(worker->render_source, ready_time);
+}
+
+/*
+ * Hand a frame to the main thread, replacing one it did not take.
+ * Called from func; due is the monotonic time the main thread should take
+ * the frame by.
+ */
+void datetime_worker_post(t_render_worker *worker, gpointer frame, gint64 due)
+{
+  gpointer old;
+
+  old = datetime_worker_exchange(worker, frame);
+  if (old != NULL)
+    worker->frame_free(old);
+
+  worker->watched = frame;
+  worker->watched_due = due;
+  g_source_set_ready_time(worker->watchdog_source, due + DATETIME_WORKER_STALL);
+}
+
+/*
+ * Take the posted frame, or NULL if there is none.
+ * The caller owns the frame.
+ */
+gpointer datetime_worker_take(t_render_worker *worker)
+{
+  gpointer frame = datetime_worker_exchange(worker, NULL);
+
+  /* in time, so the watchdog need not wake the worker */
+  if (frame != NULL)
+    g_source_set_ready_time(worker->watchdog_source, -1);
+
+  return frame;
+}
@@ -0,0 +1,54 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DATETIME_WORKER_H
+#define _DATETIME_WORKER_H	1
+
+#include <glib.h>
+
+/* how late, in microseconds, a posted frame may be taken before the main
+ * loop counts as stalled */
+#define DATETIME_WORKER_STALL 250000
+
+/* a thread with its own main context that prepares frames for the main loop */
+typedef struct _t_render_worker t_render_worker;
+
+t_render_worker *
+datetime_worker_new(GSourceFunc func,
+    gpointer data,
+    GDestroyNotify frame_free);
+
+void
+datetime_worker_free(t_render_worker *worker);
+
+void
+datetime_worker_arm(t_render_worker *worker,
+    gint64 ready_time);
+
+void
+datetime_worker_post(t_render_worker *worker,
+    gpointer frame,
+    gint64 due);
+
+gpointer
+datetime_worker_take(t_render_worker *worker);
+
+gpointer
+datetime_worker_swap(gpointer *slot,
+    gpointer value);
+
+#endif /* datetime-worker.h */
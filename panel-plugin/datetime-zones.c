@@ -0,0 +1,620 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+/* local includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libintl.h>
+#include <glib/gstdio.h>
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "datetime-zones.h"
+
+#define ZONEINFO_DIR "/usr/share/zoneinfo"
+
+/* first line of the cache file, changed with its format */
+#define ZONES_CACHE_MAGIC "# datetime plugin zone index 1"
+
+/* the offsets change with daylight saving time, so the index expires daily */
+#define ZONES_MAX_AGE (24 * 60 * 60)
+
+struct _t_zone_index {
+  gint ref_count;
+  GArray *zones;          /* t_zone, sorted by name */
+  GStringChunk *strings;  /* all strings of the zones */
+  gint64 mtime;           /* of the zoneinfo directory the index was built from */
+  gint64 built;           /* real time the offsets were computed at, in seconds */
+};
+
+typedef struct {
+  const t_zone *zone;
+  gint score;             /* lower is better */
+} t_zone_match;
+
+struct _t_zone_search {
+  t_zone_index *index;
+  gchar *query;           /* folded query of the last update */
+  GArray *matches;        /* t_zone_match of the last query, in index order */
+  GPtrArray *results;     /* zones of the matches, best first, NULL terminated */
+};
+
+/* the index of the process, shared by all instances of the plugin */
+static t_zone_index *zone_index = NULL;
+G_LOCK_DEFINE_STATIC(zone_index);
+
+static const gchar * datetime_zones_dir(void)
+{
+  const gchar *dir = g_getenv("TZDIR");
+
+  return dir != NULL ? dir : ZONEINFO_DIR;
+}
+
+static gint64 datetime_zones_mtime(const gchar *dir)
+{
+  GStatBuf st;
+
+  if (g_stat(dir, &st) != 0)
+    return -1;
+
+  return st.st_mtime;
+}
+
+static gchar * datetime_zones_cache_file(void)
+{
+  return g_build_filename(g_get_user_cache_dir(), "xfce4", "datetime-plugin",
+                          "zones", NULL);
+}
+
+/*
+ * The time zone with an identifier, e.g. "Europe/Paris", or NULL if it is
+ * not known. GLib before 2.68 cannot tell and gives UTC instead.
+ */
+GTimeZone * datetime_zone_new(const gchar *identifier)
+{
+#if GLIB_CHECK_VERSION(2, 68, 0)
+  return g_time_zone_new_identifier(identifier);
+#else
+  return g_time_zone_new(identifier);
+#endif
+}
+
+/*
+ * Lower case ASCII of a string, so that e.g. "sao" finds "São Paulo".
+ * Underscores separate the words of identifiers.
+ */
+static gchar * datetime_zones_fold(const gchar *str)
+{
+  gchar *ascii = g_str_to_ascii(str, "C");
+  gchar *folded = g_ascii_strdown(ascii, -1);
+
+  g_free(ascii);
+  g_strdelimit(folded, "_", ' ');
+
+  return folded;
+}
+
+/*
+ * Country names are translated by the iso-codes package.
+ */
+static const gchar * datetime_zones_country_name(const gchar *english)
+{
+  static gsize bound = 0;
+  const gchar *name;
+
+  if (g_once_init_enter(&bound))
+  {
+    bind_textdomain_codeset("iso_3166-1", "UTF-8");
+    bind_textdomain_codeset("iso_3166", "UTF-8");
+    g_once_init_leave(&bound, 1);
+  }
+
+  name = g_dgettext("iso_3166-1", english);
+  if (name == english)
+    name = g_dgettext("iso_3166", english);
+
+  return name;
+}
+
+static t_zone_index * datetime_zone_index_new(gint64 mtime, gint64 built)
+{
+  t_zone_index *index = g_slice_new0(t_zone_index);
+
+  index->ref_count = 1;
+  index->zones = g_array_new(FALSE, FALSE, sizeof(t_zone));
+  index->strings = g_string_chunk_new(4096);
+  index->mtime = mtime;
+  index->built = built;
+
+  return index;
+}
+
+static t_zone_index * datetime_zone_index_ref(t_zone_index *index)
+{
+  g_atomic_int_inc(&index->ref_count);
+
+  return index;
+}
+
+void datetime_zone_index_unref(t_zone_index *index)
+{
+  if (!g_atomic_int_dec_and_test(&index->ref_count))
+    return;
+
+  g_array_free(index->zones, TRUE);
+  g_string_chunk_free(index->strings);
+  g_slice_free(t_zone_index, index);
+}
+
+/*
+ * Add a zone; country is the English name of its country, or NULL.
+ */
+static void datetime_zone_index_add(t_zone_index *index,
+                                    const gchar *name,
+                                    const gchar *country,
+                                    gint offset)
+{
+  t_zone zone;
+  const gchar *base = strrchr(name, '/');
+  gchar *city, *text, *key;
+
+  city = g_strdup(base != NULL ? base + 1 : name);
+  g_strdelimit(city, "_", ' ');
+
+  zone.name = g_string_chunk_insert_const(index->strings, name);
+  zone.city = g_string_chunk_insert_const(index->strings, city);
+  zone.country = NULL;
+  if (country != NULL && *country != '\0')
+    zone.country = g_string_chunk_insert_const(index->strings,
+        datetime_zones_country_name(country));
+  zone.offset = offset;
+
+  /* both the translated and the English country name are found */
+  text = g_strjoin(" ", name, city, country != NULL ? country : "",
+                   zone.country != NULL ? zone.country : "", NULL);
+  key = datetime_zones_fold(text);
+  zone.key = g_string_chunk_insert(index->strings, key);
+
+  g_array_append_val(index->zones, zone);
+
+  g_free(key);
+  g_free(text);
+  g_free(city);
+}
+
+static gboolean datetime_zones_is_tzif(const gchar *path)
+{
+  gchar magic[4];
+  gboolean tzif;
+  FILE *file;
+
+  file = g_fopen(path, "rb");
+  if (file == NULL)
+    return FALSE;
+
+  tzif = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+         memcmp(magic, "TZif", sizeof(magic)) == 0;
+  fclose(file);
+
+  return tzif;
+}
+
+/*
+ * Collect the names of all zone files under dir.
+ */
+static void datetime_zones_walk(const gchar *dir,
+                                const gchar *prefix,
+                                GPtrArray *names)
+{
+  GDir *gdir;
+  const gchar *entry;
+  gchar *path, *name;
+
+  gdir = g_dir_open(dir, 0, NULL);
+  while (gdir != NULL && (entry = g_dir_read_name(gdir)) != NULL)
+  {
+    /* zones start with a capital letter, unlike posix/, right/ and the tables */
+    if (!g_ascii_isupper(entry[0]) || strcmp(entry, "Factory") == 0)
+      continue;
+
+    path = g_build_filename(dir, entry, NULL);
+    if (prefix != NULL)
+      name = g_strconcat(prefix, "/", entry, NULL);
+    else
+      name = g_strdup(entry);
+
+    if (g_file_test(path, G_FILE_TEST_IS_DIR))
+      datetime_zones_walk(path, name, names);
+    else if (datetime_zones_is_tzif(path))
+    {
+      g_ptr_array_add(names, name);
+      name = NULL;
+    }
+
+    g_free(name);
+    g_free(path);
+  }
+  if (gdir != NULL)
+    g_dir_close(gdir);
+}
+
+/*
+ * Read the tab separated fields of the lines of a table in dir.
+ */
+static gchar ** datetime_zones_read_table(const gchar *dir, const gchar *table)
+{
+  gchar *path, *contents = NULL;
+  gchar **lines;
+
+  path = g_build_filename(dir, table, NULL);
+  g_file_get_contents(path, &contents, NULL, NULL);
+  g_free(path);
+
+  lines = g_strsplit(contents != NULL ? contents : "", "\n", -1);
+  g_free(contents);
+
+  return lines;
+}
+
+/*
+ * Map zone names to the English names of their countries.
+ */
+static GHashTable * datetime_zones_read_countries(const gchar *dir)
+{
+  GHashTable *names, *countries;
+  gchar **lines, **fields;
+  const gchar *name;
+  guint i;
+
+  names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  lines = datetime_zones_read_table(dir, "iso3166.tab");
+  for (i = 0; lines[i] != NULL; i++)
+  {
+    fields = g_strsplit(lines[i], "\t", 2);
+    if (lines[i][0] != '#' && g_strv_length(fields) == 2)
+      g_hash_table_insert(names, g_strdup(fields[0]), g_strdup(fields[1]));
+    g_strfreev(fields);
+  }
+  g_strfreev(lines);
+
+  countries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  lines = datetime_zones_read_table(dir, "zone.tab");
+  for (i = 0; lines[i] != NULL; i++)
+  {
+    fields = g_strsplit(lines[i], "\t", 4);
+    if (lines[i][0] != '#' && g_strv_length(fields) >= 3 &&
+        (name = g_hash_table_lookup(names, fields[0])) != NULL)
+      g_hash_table_insert(countries, g_strdup(fields[2]), g_strdup(name));
+    g_strfreev(fields);
+  }
+  g_strfreev(lines);
+
+  g_hash_table_destroy(names);
+
+  return countries;
+}
+
+static gint datetime_zones_compare_names(gconstpointer a, gconstpointer b)
+{
+  return strcmp(*(const gchar **) a, *(const gchar **) b);
+}
+
+/*
+ * Walk the zoneinfo directory, parse every zone for its current offset,
+ * and write the result to the cache.
+ */
+static t_zone_index * datetime_zone_index_build(const gchar *dir, gint64 mtime)
+{
+  t_zone_index *index;
+  GPtrArray *names;
+  GHashTable *countries;
+  GString *cache;
+  GTimeZone *tz;
+  const gchar *name, *country;
+  gchar *file, *cache_dir;
+  gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+  gint offset;
+  guint i;
+
+  names = g_ptr_array_new_with_free_func(g_free);
+  datetime_zones_walk(dir, NULL, names);
+  g_ptr_array_sort(names, datetime_zones_compare_names);
+  countries = datetime_zones_read_countries(dir);
+
+  index = datetime_zone_index_new(mtime, now);
+  cache = g_string_new(ZONES_CACHE_MAGIC "\n");
+  g_string_append_printf(cache, "%" G_GINT64_FORMAT " %" G_GINT64_FORMAT "\n",
+                         mtime, now);
+
+  for (i = 0; i < names->len; i++)
+  {
+    name = g_ptr_array_index(names, i);
+    country = g_hash_table_lookup(countries, name);
+
+    tz = datetime_zone_new(name);
+    if (tz == NULL)
+      continue;
+    offset = g_time_zone_get_offset(tz,
+        g_time_zone_find_interval(tz, G_TIME_TYPE_UNIVERSAL, now));
+    g_time_zone_unref(tz);
+
+    datetime_zone_index_add(index, name, country, offset);
+    g_string_append_printf(cache, "%s\t%s\t%d\n",
+                           name, country != NULL ? country : "", offset);
+  }
+
+  /* the cache is only an optimization, so errors are ignored */
+  file = datetime_zones_cache_file();
+  cache_dir = g_path_get_dirname(file);
+  if (g_mkdir_with_parents(cache_dir, 0700) == 0)
+    g_file_set_contents(file, cache->str, cache->len, NULL);
+  g_free(cache_dir);
+  g_free(file);
+
+  g_string_free(cache, TRUE);
+  g_hash_table_destroy(countries);
+  g_ptr_array_free(names, TRUE);
+
+  DBG("built index of %u zones", index->zones->len);
+
+  return index;
+}
+
+static gboolean datetime_zone_index_valid(t_zone_index *index, gint64 mtime)
+{
+  gint64 age = g_get_real_time() / G_USEC_PER_SEC - index->built;
+
+  return index->mtime == mtime && age >= 0 && age < ZONES_MAX_AGE;
+}
+
+/*
+ * Read the index from the cache.
+ * Returns NULL if there is none, or it is outdated.
+ */
+static t_zone_index * datetime_zone_index_read(gint64 mtime)
+{
+  t_zone_index *index = NULL;
+  gchar *file, *contents = NULL;
+  gchar **lines, **fields;
+  gint64 cached_mtime, built;
+  guint i;
+
+  file = datetime_zones_cache_file();
+  g_file_get_contents(file, &contents, NULL, NULL);
+  g_free(file);
+  if (contents == NULL)
+    return NULL;
+
+  lines = g_strsplit(contents, "\n", -1);
+  g_free(contents);
+
+  if (g_strv_length(lines) >= 2 &&
+      strcmp(lines[0], ZONES_CACHE_MAGIC) == 0 &&
+      sscanf(lines[1], "%" G_GINT64_FORMAT " %" G_GINT64_FORMAT,
+             &cached_mtime, &built) == 2)
+  {
+    index = datetime_zone_index_new(cached_mtime, built);
+    if (!datetime_zone_index_valid(index, mtime))
+    {
+      datetime_zone_index_unref(index);
+      index = NULL;
+    }
+  }
+
+  for (i = 2; index != NULL && lines[i] != NULL; i++)
+  {
+    fields = g_strsplit(lines[i], "\t", 3);
+    if (g_strv_length(fields) == 3)
+      datetime_zone_index_add(index, fields[0], fields[1], atoi(fields[2]));
+    g_strfreev(fields);
+  }
+  g_strfreev(lines);
+
+  return index;
+}
+
+static void datetime_zone_index_load_thread(GTask *task,
+                                            gpointer source,
+                                            gpointer data,
+                                            GCancellable *cancellable)
+{
+  const gchar *dir = datetime_zones_dir();
+  gint64 mtime = datetime_zones_mtime(dir);
+  t_zone_index *index;
+
+  G_LOCK(zone_index);
+
+  if (zone_index == NULL || !datetime_zone_index_valid(zone_index, mtime))
+  {
+    index = datetime_zone_index_read(mtime);
+    if (index == NULL)
+      index = datetime_zone_index_build(dir, mtime);
+    if (zone_index != NULL)
+      datetime_zone_index_unref(zone_index);
+    zone_index = index;
+  }
+  index = datetime_zone_index_ref(zone_index);
+
+  G_UNLOCK(zone_index);
+
+  g_task_return_pointer(task, index, (GDestroyNotify) datetime_zone_index_unref);
+}
+
+/*
+ * Get the index in a thread: from memory, from the cache, or by building it
+ * if the zoneinfo directory changed or the offsets are a day old.
+ */
+void datetime_zone_index_load(GCancellable *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer data)
+{
+  GTask *task = g_task_new(NULL, cancellable, callback, data);
+
+  g_task_run_in_thread(task, datetime_zone_index_load_thread);
+  g_object_unref(task);
+}
+
+/*
+ * Returns a reference to the index, or NULL if loading was cancelled.
+ */
+t_zone_index * datetime_zone_index_load_finish(GAsyncResult *result,
+                                               GError **error)
+{
+  return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+static gint datetime_zone_compare_name(gconstpointer key, gconstpointer zone)
+{
+  return strcmp(key, ((const t_zone *) zone)->name);
+}
+
+const t_zone * datetime_zone_index_lookup(t_zone_index *index, const gchar *name)
+{
+  return bsearch(name, index->zones->data, index->zones->len, sizeof(t_zone),
+                 datetime_zone_compare_name);
+}
+
+t_zone_search * datetime_zone_search_new(t_zone_index *index)
+{
+  t_zone_search *search = g_slice_new0(t_zone_search);
+
+  search->index = datetime_zone_index_ref(index);
+  search->matches = g_array_new(FALSE, FALSE, sizeof(t_zone_match));
+  search->results = g_ptr_array_new();
+
+  return search;
+}
+
+void datetime_zone_search_free(t_zone_search *search)
+{
+  datetime_zone_index_unref(search->index);
+  g_array_free(search->matches, TRUE);
+  g_ptr_array_free(search->results, TRUE);
+  g_free(search->query);
+  g_slice_free(t_zone_search, search);
+}
+
+t_zone_index * datetime_zone_search_get_index(t_zone_search *search)
+{
+  return search->index;
+}
+
+/*
+ * Score how well a zone matches a folded query: best if a word of its name,
+ * city or country starts with the query, then if the query appears anywhere,
+ * then if its characters appear in order, the fewer gaps the better.
+ * Returns -1 if the zone does not match.
+ */
+static gint datetime_zone_score(const t_zone *zone, const gchar *query)
+{
+  const gchar *key = zone->key;
+  const gchar *k, *q, *last = NULL;
+  gint gaps = 0;
+
+  for (k = strstr(key, query); k != NULL; k = strstr(k + 1, query))
+    if (k == key || k[-1] == ' ' || k[-1] == '/')
+      return 0;
+
+  if (strstr(key, query) != NULL)
+    return 1;
+
+  for (k = key, q = query; *k != '\0' && *q != '\0'; k++)
+  {
+    if (*k != *q)
+      continue;
+    if (last != NULL && k != last + 1)
+      gaps++;
+    last = k;
+    q++;
+  }
+
+  return *q == '\0' ? 2 + MIN(gaps, G_MAXINT / 2) : -1;
+}
+
+static gint datetime_zone_compare_matches(gconstpointer a, gconstpointer b)
+{
+  const t_zone_match *match_a = a;
+  const t_zone_match *match_b = b;
+
+  if (match_a->score != match_b->score)
+    return match_a->score - match_b->score;
+
+  return strcmp(match_a->zone->name, match_b->zone->name);
+}
+
+/*
+ * Find the zones matching a query, best first.
+ * When the query extends the previous one, only the zones which matched
+ * that are searched, since no others can match.
+ * The returned array is owned by the search and NULL terminated.
+ */
+const t_zone * const * datetime_zone_search_update(t_zone_search *search,
+                                                   const gchar *query,
+                                                   guint *n_results)
+{
+  gchar *folded = datetime_zones_fold(query != NULL ? query : "");
+  GArray *matches, *ranked;
+  t_zone_match match;
+  gboolean refine;
+  guint i, n;
+
+  refine = search->query != NULL && g_str_has_prefix(folded, search->query);
+  n = refine ? search->matches->len : search->index->zones->len;
+
+  matches = g_array_sized_new(FALSE, FALSE, sizeof(t_zone_match), n);
+  for (i = 0; i < n; i++)
+  {
+    if (refine)
+      match.zone = g_array_index(search->matches, t_zone_match, i).zone;
+    else
+      match.zone = &g_array_index(search->index->zones, t_zone, i);
+    match.score = datetime_zone_score(match.zone, folded);
+    if (match.score >= 0)
+      g_array_append_val(matches, match);
+  }
+
+  g_array_free(search->matches, TRUE);
+  search->matches = matches;
+  g_free(search->query);
+  search->query = folded;
+
+  ranked = g_array_sized_new(FALSE, FALSE, sizeof(t_zone_match), matches->len);
+  g_array_append_vals(ranked, matches->data, matches->len);
+  g_array_sort(ranked, datetime_zone_compare_matches);
+
+  g_ptr_array_set_size(search->results, 0);
+  for (i = 0; i < ranked->len; i++)
+    g_ptr_array_add(search->results,
+                    (gpointer) g_array_index(ranked, t_zone_match, i).zone);
+  g_ptr_array_add(search->results, NULL);
+  g_array_free(ranked, TRUE);
+
+  DBG("\"%s\": %u of %u zones, refined %d",
+      folded, matches->len, search->index->zones->len, refine);
+
+  *n_results = search->results->len - 1;
+
+  return (const t_zone * const *) search->results->pdata;
+}
@@ -0,0 +1,71 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DATETIME_ZONES_H
+#define _DATETIME_ZONES_H	1
+
+#include <glib.h>
+
+/* a time zone offered by the picker */
+typedef struct {
+  const gchar *name;      /* identifier, e.g. "America/Argentina/Buenos_Aires" */
+  const gchar *city;      /* e.g. "Buenos Aires" */
+  const gchar *country;   /* localized country name, or NULL */
+  const gchar *key;       /* folded name, city and country, for searching */
+  gint offset;            /* UTC offset in seconds when the index was built */
+} t_zone;
+
+/* every zone under the zoneinfo directory, cached between runs */
+typedef struct _t_zone_index t_zone_index;
+
+/* incremental search of an index, refined as the user types */
+typedef struct _t_zone_search t_zone_search;
+
+GTimeZone *
+datetime_zone_new(const gchar *identifier);
+
+void
+datetime_zone_index_load(GCancellable *cancellable,
+    GAsyncReadyCallback callback,
+    gpointer data);
+
+t_zone_index *
+datetime_zone_index_load_finish(GAsyncResult *result,
+    GError **error);
+
+void
+datetime_zone_index_unref(t_zone_index *index);
+
+const t_zone *
+datetime_zone_index_lookup(t_zone_index *index,
+    const gchar *name);
+
+t_zone_search *
+datetime_zone_search_new(t_zone_index *index);
+
+void
+datetime_zone_search_free(t_zone_search *search);
+
+t_zone_index *
+datetime_zone_search_get_index(t_zone_search *search);
+
+const t_zone * const *
+datetime_zone_search_update(t_zone_search *search,
+    const gchar *query,
+    guint *n_results);
+
+#endif /* datetime-zones.h */
@@ -27,16 +27,42 @@
 /* local includes */
 #include <time.h>
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 /* xfce includes */
 #include <libxfce4ui/libxfce4ui.h>
 #include <libxfce4util/libxfce4util.h>
 #include <libxfce4panel/libxfce4panel.h>
 
+#include "datetime-fonts.h"
+#include "datetime-fit.h"
+#include "datetime-trace.h"
 #include "datetime.h"
 #include "datetime-dialog.h"
 
-#define DATETIME_MAX_STRLEN 256
+/* how long before an update its strings are prepared, in milliseconds */
+#define DATETIME_PRERENDER_LEAD 100
+
+/* microseconds of lead added to the learned dispatch latency */
+#define DATETIME_WAKE_MARGIN 500
+
+/* longest the main loop is held to wait for the boundary, in microseconds */
+#define DATETIME_MAX_WAKE_LEAD 10000
+
+/* quiet time after a change of the rc file before it is read, in milliseconds */
+#define DATETIME_RELOAD_DELAY 250
+
+/* quiet time after a change of the layout before it is saved, in milliseconds */
+#define DATETIME_SNAPSHOT_DELAY 2000
+
+/* changes collected between datetime_apply_begin() and datetime_apply_end() */
+#define DATETIME_APPLY_LAYOUT     (1 << 0)
+#define DATETIME_APPLY_DATE_FONT  (1 << 1)
+#define DATETIME_APPLY_TIME_FONT  (1 << 2)
+#define DATETIME_APPLY_FORMAT     (1 << 3)
+#define DATETIME_APPLY_INTERVAL   (1 << 4)
 
 /**
  *  Convert a GTimeVal to milliseconds.
@@ -51,123 +77,1013 @@ static inline gint64 datetime_gtimeval_to_ms(const GTimeVal t)
 }
 
 /*
- * Compute the wake interval,
- * which is the time remaining from the current time
- * to the next larger integral multiple of the update interval.
- * Setting a timer to this value schedules the next update
- * to occur on the next second or minute
- * when the given update interval is 1000 or 60000 milliseconds, respectively.
+ * Compute the wake interval,
+ * which is the time remaining from the current time
+ * to the next larger integral multiple of the update interval.
+ * Setting a timer to this value schedules the next update
+ * to occur on the next second or minute
+ * when the given update interval is 1000 or 60000 milliseconds, respectively.
+ */
+static inline guint datetime_wake_interval(const GTimeVal current_time,
+                                           const guint update_interval_ms)
+{
+  return update_interval_ms - (datetime_gtimeval_to_ms(current_time) %
+                               update_interval_ms);
+}
+
+/*
+ * Report how long a phase took and the resident set size,
+ * so that construction, popups and dialogs can be timed with a debug build.
+ */
+void datetime_report_timing(const gchar *phase, gint64 start_time)
+{
+#ifdef DEBUG
+  gint64 elapsed = g_get_monotonic_time() - start_time;
+  gchar *contents = NULL;
+  gulong size = 0;
+  gulong resident = 0;  /* in pages */
+
+  if (g_file_get_contents("/proc/self/statm", &contents, NULL, NULL))
+  {
+    sscanf(contents, "%lu %lu", &size, &resident);
+    g_free(contents);
+  }
+
+  DBG("%s: %" G_GINT64_FORMAT " us, rss %lu kB", phase, elapsed,
+      resident * (sysconf(_SC_PAGESIZE) / 1024));
+#endif
+}
+
+/**
+ *  Get the number of seconds between changes of a date/time format's string:
+ *  a second, a minute, an hour or a day, from the fields the compiled
+ *  format depends on. Conversions it does not know are updated every second.
+ */
+static guint datetime_format_granularity(const t_datetime_format *format)
+{
+  guint fields;
+
+  if (format == NULL)
+    return 24 * 60 * 60;
+
+  fields = datetime_format_get_fields(format);
+  if (fields & (DATETIME_FIELD_SECONDS | DATETIME_FIELD_UNKNOWN))
+    return 1;
+
+  /* the name or offset of the zone changes with the offset, on a minute */
+  if (fields & (DATETIME_FIELD_MINUTES | DATETIME_FIELD_ZONE))
+    return 60;
+
+  if (fields & DATETIME_FIELD_HOURS)
+    return 60 * 60;
+
+  return 24 * 60 * 60;
+}
+
+/*
+ * Timer which is re-armed with g_source_set_ready_time() instead of being
+ * created for every update, so the steady-state tick allocates nothing.
+ */
+static gboolean datetime_timer_dispatch(GSource *source,
+                                        GSourceFunc callback,
+                                        gpointer data)
+{
+  g_source_set_ready_time(source, -1);
+  callback(data);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs datetime_timer_funcs = {
+  NULL, NULL, datetime_timer_dispatch, NULL
+};
+
+static GSource * datetime_timer_new(gint priority,
+                                    GSourceFunc func,
+                                    t_datetime *datetime)
+{
+  GSource *source = g_source_new(&datetime_timer_funcs, sizeof(GSource));
+
+  g_source_set_priority(source, priority);
+  g_source_set_callback(source, func, datetime, NULL);
+  g_source_attach(source, NULL);
+
+  return source;
+}
+
+static gint datetime_compare_latency(gconstpointer a, gconstpointer b)
+{
+  return *(const gint *) a - *(const gint *) b;
+}
+
+/*
+ * Learn how late the main loop dispatches the update timer, and arm it
+ * early by the 99th percentile of the recent latencies.
+ */
+static void datetime_record_dispatch(t_datetime *datetime, gint64 latency)
+{
+  gint sorted[DATETIME_DISPATCH_WINDOW];
+  guint n;
+
+  datetime->dispatch_latency[datetime->dispatch_count++ % DATETIME_DISPATCH_WINDOW] =
+    CLAMP(latency, 0, G_MAXINT);
+
+  n = MIN(datetime->dispatch_count, DATETIME_DISPATCH_WINDOW);
+  memcpy(sorted, datetime->dispatch_latency, n * sizeof(gint));
+  qsort(sorted, n, sizeof(gint), datetime_compare_latency);
+
+  datetime->wake_lead = MIN(sorted[n * 99 / 100] + DATETIME_WAKE_MARGIN,
+                            DATETIME_MAX_WAKE_LEAD);
+}
+
+/*
+ * Whether the date and the time label are shown, respectively.
+ */
+static inline gboolean datetime_shows_date(t_datetime *datetime)
+{
+  return datetime->layout != LAYOUT_TIME && datetime->layout != LAYOUT_ANALOG &&
+         datetime->date_format != NULL;
+}
+
+static inline gboolean datetime_shows_time(t_datetime *datetime)
+{
+  return datetime->layout != LAYOUT_DATE && datetime->layout != LAYOUT_ANALOG &&
+         datetime->time_format != NULL;
+}
+
+/*
+ * The fonts the lines are shown with, which may be fitted to the panel
+ */
+static inline const gchar * datetime_date_font(t_datetime *datetime)
+{
+  return datetime->date_fit_font != NULL ? datetime->date_fit_font : datetime->date_match;
+}
+
+static inline const gchar * datetime_time_font(t_datetime *datetime)
+{
+  return datetime->time_fit_font != NULL ? datetime->time_fit_font : datetime->time_match;
+}
+
+/*
+ * Forget the string table of a label, e.g. after its format or locale changed.
+ * It is built again when it is needed.
+ */
+static void datetime_reset_table(t_datetime_text *text)
+{
+  datetime_string_table_free(text->table);
+  text->table = NULL;
+  text->no_table = FALSE;
+}
+
+/*
+ * Break a time down in the zone of the plugin, or the local one.
+ */
+static void datetime_localtime(t_datetime *datetime, time_t stamp, struct tm *tm)
+{
+  gint64 stamp64 = stamp;
+
+  datetime_format_decompose(&stamp64, 1, datetime->tz, tm);
+}
+
+/*
+ * Look up the string of a label in the table of all its strings for the
+ * minutes of a day or the days of a year, building the table if needed.
+ * Returns FALSE if the format does not allow a table.
+ */
+static gboolean datetime_render_from_table(t_datetime_text *text,
+                                           const gchar *format,
+                                           GTimeZone *tz,
+                                           const struct tm *tm,
+                                           gchar *buf)
+{
+  const gchar *str = NULL;
+
+  if (text->no_table || text->markup != NULL)
+    return FALSE;
+
+  if (text->table != NULL)
+    str = datetime_string_table_lookup(text->table, tm);
+
+  /* a day-of-year table is built again in a new year */
+  if (str == NULL)
+  {
+    datetime_string_table_free(text->table);
+    text->table = datetime_string_table_new(format, text->locale, tz, tm);
+    if (text->table == NULL)
+    {
+      text->no_table = TRUE;
+      return FALSE;
+    }
+    str = datetime_string_table_lookup(text->table, tm);
+  }
+
+  g_strlcpy(buf, str, DATETIME_TEXT_SIZE);
+
+  return TRUE;
+}
+
+/*
+ * Render the string of a label for the given time into its next buffer.
+ * The string is only formatted when the time moved into another period of
+ * the format's granularity; otherwise the shown string is reused.
+ * Labels without a format get an empty string.
+ */
+static void datetime_render_text(t_datetime_text *text, guint next,
+                                 const gchar *format, gboolean use_table,
+                                 GTimeZone *tz, time_t stamp, const struct tm *tm)
+{
+  gint64 period;
+
+  if (format == NULL)
+  {
+    text->text[next][0] = '\0';
+    text->period[next] = -1;
+    return;
+  }
+
+  period = ((gint64) stamp + tm->tm_gmtoff) / MAX(text->granularity, 1);
+  if (text->period[next] == period)
+    return;
+
+  if (text->period[!next] == period)
+  {
+    strcpy(text->text[next], text->text[!next]);
+    if (text->markup != NULL)
+      datetime_markup_copy(text->markup, !next, next);
+  }
+  else if (use_table && datetime_render_from_table(text, format, tz, tm, text->text[next]))
+    ;
+  else if (text->markup != NULL)
+    datetime_markup_render(text->markup, text->locale, tm, text->text[next], next);
+  else if (datetime_format_render(text->compiled, text->locale, tm,
+                                  text->text[next], DATETIME_TEXT_SIZE) == 0)
+    g_strlcpy(text->text[next], _("Invalid format"), DATETIME_TEXT_SIZE);
+  text->period[next] = period;
+}
+
+/*
+ * Forget for which periods the strings were rendered, e.g. after a format change.
+ * The strings are cleared, so that the label and its attributes are set again
+ * even if only the markup changed.
+ */
+static void datetime_invalidate_text(t_datetime_text *text)
+{
+  text->period[0] = -1;
+  text->period[1] = -1;
+  text->text[0][0] = '\0';
+  text->text[1][0] = '\0';
+  text->granularity = datetime_format_granularity(text->compiled);
+}
+
+/*
+ * Render the strings shown in the panel for the given time
+ * into the buffers for the next update.
+ * Labels hidden by the layout get an empty string, so that they are set
+ * again once they are shown.
+ */
+static void datetime_render(t_datetime *datetime, time_t stamp, const struct tm *tm)
+{
+  t_segment *segment;
+  guint i;
+
+  datetime_render_text(&datetime->date_text, datetime->text_next,
+                       datetime_shows_date(datetime) ? datetime->date_format : NULL,
+                       datetime->string_tables, datetime->tz, stamp, tm);
+  datetime_render_text(&datetime->time_text, datetime->text_next,
+                       datetime_shows_time(datetime) ? datetime->time_format : NULL,
+                       datetime->string_tables, datetime->tz, stamp, tm);
+
+  for (i = 0; datetime->segments != NULL && i < datetime->segments->len; i++)
+  {
+    segment = g_ptr_array_index(datetime->segments, i);
+    datetime_render_text(&segment->text, datetime->text_next,
+                         segment->format, datetime->string_tables,
+                         datetime->tz, stamp, tm);
+  }
+}
+
+/*
+ * Put the shown string into its label if it differs from the previous one.
+ * Attributes of markup formats only need to be moved to the new offsets.
+ * Returns TRUE if the label was changed.
+ */
+static gboolean datetime_set_text(GtkWidget *label, t_datetime_text *text, guint shown)
+{
+  if (!GTK_IS_LABEL(label) || strcmp(text->text[shown], text->text[!shown]) == 0)
+    return FALSE;
+
+  gtk_label_set_text(GTK_LABEL(label), text->text[shown]);
+  if (text->markup != NULL)
+    datetime_markup_apply(text->markup, GTK_LABEL(label), shown);
+
+  return TRUE;
+}
+
+/*
+ * Build what the worker renders from the current settings. The job has
+ * formats and locales of its own, so that the settings may change while
+ * the worker renders an older job.
+ */
+static void datetime_build_render_job(t_datetime *datetime)
+{
+  t_render_job *job;
+  t_segment *segment;
+  guint i;
+
+  if (datetime->render_job != NULL)
+    datetime_render_job_unref(datetime->render_job);
+
+  job = datetime_render_job_new(++datetime->render_generation, datetime->tz,
+                                datetime->update_interval,
+                                2 + datetime->segments->len);
+  datetime_render_job_set_text(job, 0,
+      datetime_shows_date(datetime) ? datetime->date_format : NULL,
+      datetime->date_locale);
+  datetime_render_job_set_text(job, 1,
+      datetime_shows_time(datetime) ? datetime->time_format : NULL,
+      datetime->time_locale);
+  for (i = 0; i < datetime->segments->len; i++)
+  {
+    segment = g_ptr_array_index(datetime->segments, i);
+    datetime_render_job_set_text(job, 2 + i, segment->format, segment->locale);
+  }
+  datetime_render_job_seal(job);
+
+  datetime->render_job = job;
+}
+
+/*
+ * Drop the strings prepared for the next update, e.g. after a format change.
+ * A frame the worker is rendering is posted later and dropped when it is
+ * collected, as it is not for the requested time.
+ */
+static void datetime_discard_prerender(t_datetime *datetime)
+{
+  t_render_frame *frame;
+
+  if (datetime->worker == NULL)
+    return;
+
+  datetime_worker_arm(datetime->worker, -1);
+
+  frame = datetime_worker_swap(&datetime->render_request, NULL);
+  if (frame != NULL)
+    datetime_render_frame_release(frame);
+  frame = datetime_worker_take(datetime->worker);
+  if (frame != NULL)
+    datetime_render_frame_release(frame);
+
+  datetime->render_stamp = 0;
+  datetime->next_stamp = 0;
+}
+
+/*
+ * Prepare the strings for the upcoming update on the worker thread,
+ * so that the main loop only has to put them into the labels,
+ * and they are ready as soon as a stalled main loop runs again.
+ * Only the requested frame and its job are touched here.
+ */
+static gboolean datetime_worker_render(t_datetime *datetime)
+{
+  t_render_frame *frame = datetime_worker_swap(&datetime->render_request, NULL);
+
+  if (frame != NULL)
+  {
+    datetime_render_frame_render(frame);
+    datetime_worker_post(datetime->worker, frame, frame->due);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+/*
+ * Put a string of the frame into the next buffer of its label,
+ * as if it was rendered there
+ */
+static void datetime_take_frame_text(t_datetime_text *text,
+                                     guint next,
+                                     const t_render_frame *frame,
+                                     guint i)
+{
+  const guint *offsets;
+
+  if (!datetime_render_frame_is_shown(frame, i))
+  {
+    text->text[next][0] = '\0';
+    text->period[next] = -1;
+    return;
+  }
+
+  g_strlcpy(text->text[next], datetime_render_frame_get_text(frame, i),
+            DATETIME_TEXT_SIZE);
+  offsets = datetime_render_frame_get_offsets(frame, i);
+  if (offsets != NULL && text->markup != NULL)
+    datetime_markup_set_offsets(text->markup, next, offsets);
+  text->period[next] = ((gint64) frame->stamp + frame->gmtoff) /
+                       MAX(text->granularity, 1);
+}
+
+/*
+ * Take the strings the worker posted for this update, if any, into the
+ * next buffers. Strings of an older job or for another time are dropped.
+ */
+static void datetime_collect_prerender(t_datetime *datetime)
+{
+  t_render_frame *frame = datetime_worker_take(datetime->worker);
+  t_segment *segment;
+  guint i;
+
+  if (frame == NULL)
+    return;
+
+  if (frame->job == datetime->render_job &&
+      datetime_render_job_get_generation(frame->job) == datetime->render_generation &&
+      datetime_render_job_get_update_interval(frame->job) == datetime->update_interval &&
+      datetime_render_job_get_n_texts(frame->job) == 2 + datetime->segments->len &&
+      frame->stamp == datetime->render_stamp)
+  {
+    datetime_take_frame_text(&datetime->date_text, datetime->text_next, frame, 0);
+    datetime_take_frame_text(&datetime->time_text, datetime->text_next, frame, 1);
+    for (i = 0; i < datetime->segments->len; i++)
+    {
+      segment = g_ptr_array_index(datetime->segments, i);
+      datetime_take_frame_text(&segment->text, datetime->text_next, frame, 2 + i);
+    }
+    datetime->next_stamp = frame->stamp;
+    datetime->next_gmtoff = frame->gmtoff;
+  }
+  datetime_render_frame_release(frame);
+}
+
+/*
+ * Render the strings for the upcoming update right away,
+ * when the worker did not get to it in time.
+ */
+static void datetime_prerender(t_datetime *datetime)
+{
+  time_t stamp;
+  struct tm next;
+
+  datetime_discard_prerender(datetime);
+
+  stamp = datetime->wake_time / 1000;
+  datetime_localtime(datetime, stamp, &next);
+
+  datetime_render(datetime, stamp, &next);
+  datetime->next_stamp = stamp;
+  datetime->next_gmtoff = next.tm_gmtoff;
+}
+
+/*
+ * Whether the prepared strings are valid for the given time,
+ * i.e. they were rendered for the same update interval and UTC offset.
+ */
+static gboolean datetime_prerender_matches(t_datetime *datetime,
+                                           time_t stamp,
+                                           const struct tm *tm)
+{
+  const time_t interval = datetime->update_interval / 1000;
+
+  return datetime->next_stamp != 0 &&
+         datetime->next_stamp / interval == stamp / interval &&
+         datetime->next_gmtoff == tm->tm_gmtoff;
+}
+
+/*
+ * Monotonic time a coalesced update fires at: its boundary rounded up to a
+ * whole second of the monotonic clock, so that the coalesced updates of all
+ * clocks of the session wake up together. It is never before the boundary.
+ */
+static gint64 datetime_coalesced_ready_time(gint64 boundary)
+{
+  return (boundary + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC * G_USEC_PER_SEC;
+}
+
+/*
+ * Start the timer for the next update.
+ * Updates which show seconds are aligned exactly on the boundary.
+ * Minute updates may be coalesced on whole seconds of the monotonic clock
+ * when the user configured some slack.
+ */
+static void datetime_schedule_update(t_datetime *datetime,
+                                     const GTimeVal current_time)
+{
+  guint wake_interval;  /* milliseconds to next update */
+  gint64 now = g_get_monotonic_time();
+  t_render_frame *frame;
+
+  /* Compute the time to the next update and start the timer. */
+  wake_interval = datetime_wake_interval(current_time, datetime->update_interval);
+  datetime->wake_time = datetime_gtimeval_to_ms(current_time) + wake_interval;
+
+  /* coalesced updates may be up to a second and the slack late */
+  datetime->update_due = now + (gint64) wake_interval * 1000;
+  if (datetime->coalesce)
+    datetime->update_due += (gint64) (1000 + datetime->timer_slack) * 1000;
+
+  if (datetime->coalesce)
+  {
+    /* the wake interval is computed from truncated milliseconds,
+     * so it ends at or after the boundary */
+    g_source_set_ready_time(datetime->update_source,
+        datetime_coalesced_ready_time(now + (gint64) wake_interval * 1000));
+  }
+  else
+  {
+    /* wake early by the usual dispatch latency, then wait for the boundary */
+    datetime->update_ready = now - datetime->wake_lead +
+      (datetime->wake_time * 1000 - g_get_real_time());
+    g_source_set_ready_time(datetime->update_source, datetime->update_ready);
+  }
+
+  /* have the worker prepare the strings shortly before */
+  if (wake_interval > DATETIME_PRERENDER_LEAD && datetime->render_job != NULL &&
+      (frame = datetime_render_frame_acquire(datetime->render_job,
+                                             datetime->wake_time / 1000)) != NULL)
+  {
+    frame->due = datetime->update_due;
+    datetime->render_stamp = frame->stamp;
+    frame = datetime_worker_swap(&datetime->render_request, frame);
+    if (frame != NULL)
+      datetime_render_frame_release(frame);
+    datetime_worker_arm(datetime->worker,
+        now + (gint64) (wake_interval - DATETIME_PRERENDER_LEAD) * 1000);
+  }
+}
+
+/*
+ * Record how late the update ran compared to the boundary it was meant for,
+ * and stop coalescing if that keeps exceeding the configured slack.
+ */
+static void datetime_check_lateness(t_datetime *datetime,
+                                    const GTimeVal current_time)
+{
+  gint64 lateness;
+
+  /* not woken by the timer, e.g. after a settings change */
+  lateness = datetime_gtimeval_to_ms(current_time) - datetime->wake_time;
+  if (datetime->wake_time == 0 || lateness < 0)
+    return;
+
+  datetime->wake_lateness = MIN(lateness, G_MAXUINT);
+  datetime->wake_lateness_max = MAX(datetime->wake_lateness_max,
+                                    datetime->wake_lateness);
+  DBG("lateness: %u ms (max %u ms, slack %u ms, coalesced %d)",
+      datetime->wake_lateness, datetime->wake_lateness_max,
+      datetime->timer_slack, datetime->coalesce);
+
+  if (!datetime->coalesce)
+    return;
+
+  /*
+   * The first coalesced wakeup may be up to a second later than the steady
+   * state, so only give up after two overshoots in a row.
+   */
+  if (datetime->wake_lateness <= datetime->timer_slack)
+    datetime->wake_overshoots = 0;
+  else if (++datetime->wake_overshoots >= 2)
+  {
+    DBG("coalesced updates exceed the slack, using exact timers");
+    datetime->coalesce = FALSE;
+  }
+}
+
+/*
+ * Show the labels the layout asks for, the area drawing them from cached
+ * glyphs on vertical panels, or the clock face.
+ */
+static void datetime_show_labels(t_datetime *datetime)
+{
+  gboolean analog = (datetime->layout == LAYOUT_ANALOG);
+  t_segment *segment;
+  guint i;
+
+  gtk_widget_set_visible(datetime->date_label, !datetime->rotated && !analog &&
+                         datetime->layout != LAYOUT_TIME);
+  gtk_widget_set_visible(datetime->time_label, !datetime->rotated && !analog &&
+                         datetime->layout != LAYOUT_DATE);
+  for (i = 0; i < datetime->segments->len; i++)
+  {
+    segment = g_ptr_array_index(datetime->segments, i);
+    gtk_widget_set_visible(segment->label, !datetime->rotated);
+  }
+  gtk_widget_set_visible(datetime->rotated_area, datetime->rotated);
+  gtk_widget_set_visible(datetime->analog_area, analog);
+}
+
+/*
+ * The rotated lines are the date, the time and then the segments.
+ */
+static guint datetime_rotated_count(t_datetime *datetime)
+{
+  return 2 + datetime->segments->len;
+}
+
+static t_rotated_line * datetime_rotated_nth(t_datetime *datetime, guint n,
+                                             GtkWidget **label)
+{
+  t_segment *segment;
+
+  if (n == 0)
+  {
+    *label = datetime->date_label;
+    return datetime->rotated_date;
+  }
+  if (n == 1)
+  {
+    *label = datetime->time_label;
+    return datetime->rotated_time;
+  }
+
+  segment = g_ptr_array_index(datetime->segments, n - 2);
+  *label = segment->label;
+  return segment->rotated;
+}
+
+/*
+ * Position of the top left corner of a rotated line within the area.
+ * The lines are placed side by side in the order of their labels.
+ */
+static void datetime_rotated_origin(t_datetime *datetime, guint n,
+                                    gint *x, gint *y)
+{
+  t_rotated_line *line;
+  GtkWidget *label;
+  gint thickness, length, total = 0, before = 0;
+  gint pos, line_pos = 0;
+  guint i;
+
+  datetime_rotated_nth(datetime, n, &label);
+  gtk_container_child_get(GTK_CONTAINER(datetime->box), label,
+                          "position", &line_pos, NULL);
+
+  for (i = 0; i < datetime_rotated_count(datetime); i++)
+  {
+    line = datetime_rotated_nth(datetime, i, &label);
+    datetime_rotated_line_get_size(line, &thickness, &length);
+    total += thickness;
+    if (i == n)
+    {
+      *y = (gtk_widget_get_allocated_height(datetime->rotated_area) - length) / 2;
+      continue;
+    }
+
+    gtk_container_child_get(GTK_CONTAINER(datetime->box), label,
+                            "position", &pos, NULL);
+    if (pos < line_pos)
+      before += thickness;
+  }
+
+  *x = (gtk_widget_get_allocated_width(datetime->rotated_area) - total) / 2 + before;
+}
+
+static gboolean datetime_rotated_draw(GtkWidget *widget,
+                                      cairo_t *cr,
+                                      t_datetime *datetime)
+{
+  GtkStyleContext *context = gtk_widget_get_style_context(widget);
+  GtkWidget *label;
+  GdkRGBA color;
+  gint x, y;
+  guint i;
+
+  gtk_style_context_get_color(context, gtk_style_context_get_state(context), &color);
+
+  for (i = 0; i < datetime_rotated_count(datetime); i++)
+  {
+    datetime_rotated_origin(datetime, i, &x, &y);
+    datetime_rotated_line_draw(datetime_rotated_nth(datetime, i, &label),
+                               cr, x, y, &color);
+  }
+
+  return FALSE;
+}
+
+/*
+ * Invalidate a rotated line from the first glyph that changed.
+ * The ink of the glyphs may reach out of the logical size of the line, so
+ * the area is invalidated across its width and to its bottom.
+ */
+static void datetime_rotated_queue_draw(t_datetime *datetime, guint n,
+                                        gint changed_from)
+{
+  gint x, y;
+
+  if (changed_from < 0)
+    return;
+
+  datetime_rotated_origin(datetime, n, &x, &y);
+  gtk_widget_queue_draw_area(datetime->rotated_area,
+      0, y + changed_from,
+      gtk_widget_get_allocated_width(datetime->rotated_area),
+      gtk_widget_get_allocated_height(datetime->rotated_area) - y - changed_from);
+}
+
+/*
+ * The text a rotated line shows, or NULL if it cannot be drawn from glyphs.
+ */
+static gboolean datetime_rotated_text(t_datetime *datetime, guint n,
+                                      const gchar **text, const gchar **font)
+{
+  t_segment *segment;
+
+  *text = NULL;
+  if (n == 0)
+  {
+    *font = datetime_date_font(datetime);
+    if (datetime->layout != LAYOUT_TIME)
+      *text = gtk_label_get_text(GTK_LABEL(datetime->date_label));
+    return datetime->date_text.markup == NULL;
+  }
+  if (n == 1)
+  {
+    *font = datetime_time_font(datetime);
+    if (datetime->layout != LAYOUT_DATE)
+      *text = gtk_label_get_text(GTK_LABEL(datetime->time_label));
+    return datetime->time_text.markup == NULL;
+  }
+
+  segment = g_ptr_array_index(datetime->segments, n - 2);
+  *font = segment->font != NULL ?
+    datetime_font_resolve(segment->label, segment->font)->font : NULL;
+  *text = gtk_label_get_text(GTK_LABEL(segment->label));
+
+  /* a segment turned by its own angle keeps its label */
+  return segment->text.markup == NULL && segment->angle == 0;
+}
+
+/*
+ * On vertical panels, draw the label texts from pre-rotated glyphs instead of
+ * letting the labels lay out rotated text on every update.
+ * Text the glyph cache cannot draw correctly falls back to the rotated labels.
+ */
+static void datetime_update_rotated(t_datetime *datetime)
+{
+  GtkWidget *label;
+  const gchar *text, *font;
+  gint thickness, length, changed_from;
+  gint width = 0, height = 0;
+  gboolean rotated;
+  gboolean resized = FALSE;
+  guint i, n = datetime_rotated_count(datetime);
+
+  /* cached glyphs cannot carry the attributes of markup formats */
+  rotated = datetime->vertical && datetime->layout != LAYOUT_ANALOG;
+  for (i = 0; rotated && i < n; i++)
+    rotated = datetime_rotated_text(datetime, i, &text, &font) &&
+              datetime_rotated_text_supported(text);
+
+  if (rotated != datetime->rotated)
+  {
+    datetime->rotated = rotated;
+    datetime_show_labels(datetime);
+  }
+
+  if (!rotated)
+    return;
+
+  for (i = 0; i < n; i++)
+  {
+    datetime_rotated_text(datetime, i, &text, &font);
+    resized |= datetime_rotated_line_set_text(
+        datetime_rotated_nth(datetime, i, &label),
+        datetime->rotated_area, font, text, &changed_from);
+    if (!resized)
+      datetime_rotated_queue_draw(datetime, i, changed_from);
+  }
+
+  if (resized)
+  {
+    for (i = 0; i < n; i++)
+    {
+      datetime_rotated_line_get_size(
+          datetime_rotated_nth(datetime, i, &label),
+          &thickness, &length);
+      width += thickness;
+      height = MAX(height, length);
+    }
+    gtk_widget_set_size_request(datetime->rotated_area, width, height);
+    gtk_widget_queue_draw(datetime->rotated_area);
+  }
+}
+
+/*
+ * The font options or scale of the screen changed; rasterize the glyphs again.
+ */
+static void datetime_rotated_style_updated(t_datetime *datetime)
+{
+  GtkWidget *label;
+  guint i;
+
+  for (i = 0; i < datetime_rotated_count(datetime); i++)
+    datetime_rotated_line_flush(datetime_rotated_nth(datetime, i, &label));
+  datetime_update_rotated(datetime);
+}
+
+static gboolean datetime_analog_draw(GtkWidget *widget,
+                                     cairo_t *cr,
+                                     t_datetime *datetime)
+{
+  datetime_analog_face_draw(datetime->analog, widget, cr);
+
+  return FALSE;
+}
+
+/*
+ * The font of the numerals may have changed; draw the dial again.
+ */
+static void datetime_analog_style_updated(t_datetime *datetime)
+{
+  datetime_analog_face_flush(datetime->analog);
+  gtk_widget_queue_draw(datetime->analog_area);
+}
+
+/*
+ * set date and time labels
+ */
+gboolean datetime_update(t_datetime *datetime)
+{
+  GTimeVal timeval;
+  struct tm current;
+  gboolean prerendered;
+  gboolean changed = FALSE;
+  guint shown;
+  t_segment *segment;
+  guint i;
+  gint64 boundary = datetime->wake_time * 1000;  /* in microseconds */
+  gint64 early = 0;
+  gboolean exact;
+  gint64 fired = g_get_real_time();
+  gint64 start_time = g_get_monotonic_time();
+  gint64 trace_time = datetime_trace_begin();
+
+  DBG("wake");
+
+  datetime_collect_prerender(datetime);
+
+  /* woken by the exact timer, rather than e.g. after a settings change */
+  exact = datetime->update_ready != 0 && start_time >= datetime->update_ready;
+  if (exact)
+    datetime_record_dispatch(datetime, start_time - datetime->update_ready);
+  datetime->update_ready = 0;
+
+  /* stop timer */
+  g_source_set_ready_time(datetime->update_source, -1);
+
+  /*
+   * Woken ahead of the boundary: make sure the strings are ready and
+   * come back at it, so that the next second is never shown too early.
+   * A clock stepped back by more than the lead shows the time now and
+   * the next boundary is computed from it.
+   */
+  if (exact)
+    early = boundary - fired;
+  if (early > 0 && early <= DATETIME_MAX_WAKE_LEAD)
+  {
+    if (datetime->next_stamp == 0)
+      datetime_prerender(datetime);
+    datetime->update_ready = start_time + early;
+    g_source_set_ready_time(datetime->update_source, datetime->update_ready);
+    datetime_trace_end(trace_time, "early");
+    return TRUE;
+  }
+
+  timeval.tv_sec = fired / G_USEC_PER_SEC;
+  timeval.tv_usec = fired % G_USEC_PER_SEC;
+  datetime_localtime(datetime, timeval.tv_sec, &current);
+
+  datetime_check_lateness(datetime, timeval);
+
+  /* render now unless the strings were prepared ahead of time */
+  prerendered = datetime_prerender_matches(datetime, timeval.tv_sec, &current);
+  if (!prerendered)
+  {
+    datetime_discard_prerender(datetime);
+    datetime_render(datetime, timeval.tv_sec, &current);
+  }
+
+  /* the next strings become the shown ones; only changed ones are set */
+  shown = datetime->text_next;
+  datetime->text_next = !shown;
+
+  if (datetime_shows_date(datetime))
+    changed |= datetime_set_text(datetime->date_label, &datetime->date_text, shown);
+
+  if (datetime_shows_time(datetime))
+    changed |= datetime_set_text(datetime->time_label, &datetime->time_text, shown);
+
+  for (i = 0; datetime->segments != NULL && i < datetime->segments->len; i++)
+  {
+    segment = g_ptr_array_index(datetime->segments, i);
+    changed |= datetime_set_text(segment->label, &segment->text, shown);
+  }
+
+  /* the face has a second hand while it is updated every second */
+  if (datetime->layout == LAYOUT_ANALOG)
+  {
+    datetime_analog_face_set_time(datetime->analog, datetime->analog_area,
+                                  &current, datetime->update_interval == 1000);
+    changed = TRUE;
+  }
+
+  datetime_update_rotated(datetime);
+
+  /* measure updates woken by the timer from their boundary to the screen */
+  if (changed && boundary != 0 && datetime_gtimeval_to_ms(timeval) >= datetime->wake_time)
+    datetime_latency_tick(datetime->latency, datetime->button, boundary,
+                          fired, g_get_real_time());
+
+  DBG("boundary to set: %" G_GINT64_FORMAT " us (prerendered %d)",
+      g_get_real_time() - datetime->wake_time * 1000, prerendered);
+  datetime_report_timing("tick", start_time);
+
+  datetime_discard_prerender(datetime);
+  datetime_schedule_update(datetime, timeval);
+
+  datetime_trace_end(trace_time, "update");
+
+  return TRUE;
+}
+
+/*
+ * Whether the battery is low enough to throttle updates.
  */
-static inline guint datetime_wake_interval(const GTimeVal current_time,
-                                           const guint update_interval_ms)
+static gboolean datetime_on_low_battery(t_datetime *datetime)
 {
-  return update_interval_ms - (datetime_gtimeval_to_ms(current_time) %
-                               update_interval_ms);
+  return datetime->power != NULL &&
+         datetime_power_monitor_throttles(datetime->power,
+                                          datetime->battery_throttle);
 }
 
-/*
- * Get date/time string
- */
-gchar * datetime_do_utf8strftime(const char *format, const struct tm *tm)
+static void datetime_set_update_interval(t_datetime *datetime)
 {
-  int len;
-  gchar buf[DATETIME_MAX_STRLEN];
-  gchar *utf8str = NULL;
+  t_segment *segment;
+  gboolean has_seconds;
+  guint i;
 
-  /* get formatted date/time */
-  len = strftime(buf, sizeof(buf)-1, format, tm);
-  if (len == 0)
-    return g_strdup(_("Invalid format"));
+  /* strings prepared with the old settings are useless now */
+  datetime_discard_prerender(datetime);
 
-  buf[len] = '\0';  /* make sure nul terminated string */
-  utf8str = g_locale_to_utf8(buf, -1, NULL, NULL, NULL);
-  if(utf8str == NULL)
-    return g_strdup(_("Error"));
+  /* a custom date format could specify seconds */
+  datetime_invalidate_text(&datetime->date_text);
+  datetime_invalidate_text(&datetime->time_text);
 
-  return utf8str;
-}
+  /* set update interval for the date/time displayed in the panel */
+  has_seconds = (datetime_shows_date(datetime) && datetime->date_text.granularity == 1) ||
+                (datetime_shows_time(datetime) && datetime->time_text.granularity == 1);
 
-/**
- *  Check whether date/time format shows seconds
- */
-static gboolean datetime_format_has_seconds(const gchar *format)
-{
-  static struct tm time_struct = {
-    .tm_sec   = 0,
-    .tm_min   = 0,
-    .tm_hour  = 0,
-    .tm_mday  = 1,
-    .tm_mon   = 0,
-    .tm_year  = 70, /* use 1970 so strftime() can convert '%s' */
-    .tm_wday  = 0,
-    .tm_yday  = 0,
-    .tm_isdst = 0
-  };
-  int len1;
-  int len2;
-  gchar buf1[DATETIME_MAX_STRLEN];
-  gchar buf2[DATETIME_MAX_STRLEN];
+  /* the clock face shows a second hand if the time format shows seconds */
+  has_seconds |= (datetime->layout == LAYOUT_ANALOG &&
+                  datetime->time_text.granularity == 1);
 
-  if (format == NULL)
-    return FALSE;
+  /* all segments share the same timer */
+  for (i = 0; datetime->segments != NULL && i < datetime->segments->len; i++)
+  {
+    segment = g_ptr_array_index(datetime->segments, i);
+    datetime_invalidate_text(&segment->text);
+    has_seconds |= (segment->text.granularity == 1);
+  }
 
-  time_struct.tm_sec = 1;
-  len1 = strftime(buf1, sizeof(buf1)-1, format, &time_struct);
-  if (len1 == 0)
-    return FALSE;
-  buf1[len1] = '\0';
+  /*
+   * On battery, seconds are only kept ticking while the user looks at them,
+   * i.e. while the pointer is over the plugin or the calendar is open.
+   */
+  datetime->throttled = has_seconds && datetime_on_low_battery(datetime) &&
+                        !datetime->hovered && datetime->cal == NULL;
 
-  time_struct.tm_sec = 2;
-  len2 = strftime(buf2, sizeof(buf2)-1, format, &time_struct);
-  if (len2 == 0)
-    return FALSE;
-  buf2[len2] = '\0';
+  /* 1000 ms in 1 second */
+  datetime->update_interval = 1000 * ((has_seconds && !datetime->throttled) ? 1 : 60);
+
+  /* only minute updates can afford to be late */
+  datetime->coalesce = datetime->update_interval > 1000 && datetime->timer_slack > 0;
+  datetime->wake_overshoots = 0;
+  datetime->wake_lateness_max = 0;
 
-  return len1 != len2 || strcmp(buf1, buf2) != 0;
+  datetime_build_render_job(datetime);
 }
 
 /*
- * set date and time labels
+ * Recompute the update interval after a change of the power state,
+ * hovering or the popup, and restart the timer if the interval changed.
  */
-gboolean datetime_update(t_datetime *datetime)
+static void datetime_refresh_interval(t_datetime *datetime)
 {
-  GTimeVal timeval;
-  gchar *utf8str;
-  struct tm *current;
-  guint wake_interval;  /* milliseconds to next update */
-
-  DBG("wake");
-
-  /* stop timer */
-  if (datetime->timeout_id)
-  {
-    g_source_remove(datetime->timeout_id);
-  }
-
-  g_get_current_time(&timeval);
-  current = localtime((time_t *)&timeval.tv_sec);
+  guint old_interval = datetime->update_interval;
 
-  if (datetime->layout != LAYOUT_TIME &&
-      datetime->date_format != NULL && GTK_IS_LABEL(datetime->date_label))
-  {
-    utf8str = datetime_do_utf8strftime(datetime->date_format, current);
-    gtk_label_set_text(GTK_LABEL(datetime->date_label), utf8str);
-    g_free(utf8str);
-  }
-
-  if (datetime->layout != LAYOUT_DATE &&
-      datetime->time_format != NULL && GTK_IS_LABEL(datetime->time_label))
-  {
-    utf8str = datetime_do_utf8strftime(datetime->time_format, current);
-    gtk_label_set_text(GTK_LABEL(datetime->time_label), utf8str);
-    g_free(utf8str);
-  }
+  datetime_set_update_interval(datetime);
+  if (datetime->update_interval != old_interval)
+    datetime_update(datetime);
+}
 
-  /* Compute the time to the next update and start the timer. */
-  wake_interval = datetime_wake_interval(timeval, datetime->update_interval);
-  datetime->timeout_id = g_timeout_add(wake_interval, (GSourceFunc) datetime_update, datetime);
+static gboolean datetime_crossing(GtkWidget *widget,
+                                  GdkEventCrossing *event,
+                                  t_datetime *datetime)
+{
+  datetime->hovered = (event->type == GDK_ENTER_NOTIFY);
+  if (datetime_on_low_battery(datetime))
+    datetime_refresh_interval(datetime);
 
-  return TRUE;
+  return FALSE;
 }
 
 static gboolean datetime_tooltip_timer(t_datetime *datetime)
@@ -195,32 +1111,39 @@ static gboolean datetime_query_tooltip(GtkWidget *widget,
                                        t_datetime *datetime)
 {
   GTimeVal timeval;
-  struct tm *current;
-  gchar *utf8str;
-  gchar *format = NULL;
+  struct tm current;
+  gchar text[DATETIME_TEXT_SIZE];
+  t_datetime_text *shown = NULL;
   guint wake_interval;  /* milliseconds to next update */
+  gint64 trace_time = datetime_trace_begin();
 
   switch(datetime->layout)
   {
     case LAYOUT_TIME:
-      format = datetime->date_format;
+    case LAYOUT_ANALOG:
+      shown = &datetime->date_text;
       break;
     case LAYOUT_DATE:
-      format = datetime->time_format;
+      shown = &datetime->time_text;
       break;
     default:
       break;
   }
 
-  if (format == NULL)
+  /* the tooltip shows the format of the hidden label, without markup */
+  if (shown == NULL || shown->compiled == NULL)
+  {
+    datetime_trace_end(trace_time, "tooltip");
     return FALSE;
+  }
 
   g_get_current_time(&timeval);
-  current = localtime((time_t *)&timeval.tv_sec);
+  datetime_localtime(datetime, timeval.tv_sec, &current);
 
-  utf8str = datetime_do_utf8strftime(format, current);
-  gtk_tooltip_set_text(tooltip, utf8str);
-  g_free(utf8str);
+  if (datetime_format_render(shown->compiled, shown->locale, &current,
+                             text, sizeof(text)) == 0)
+    g_strlcpy(text, _("Invalid format"), sizeof(text));
+  gtk_tooltip_set_text(tooltip, text);
 
   /* if there is no active timeout to update the tooltip, register one */
   if (!datetime->tooltip_timeout_id)
@@ -234,6 +1157,8 @@ static gboolean datetime_query_tooltip(GtkWidget *widget,
       (GSourceFunc) datetime_tooltip_timer, datetime);
   }
 
+  datetime_trace_end(trace_time, "tooltip");
+
   return TRUE;
 }
 
@@ -249,8 +1174,31 @@ static void on_calendar_realized(GtkWidget *widget, t_datetime *datetime)
 
 static gboolean close_calendar_window(t_datetime *datetime)
 {
+  GtkWidget *cal;
+  guint i;
+
+  /* keep the pooled calendars alive for the next popup */
+  for (i = 0; i < DATETIME_CALENDAR_MONTHS; i++)
+  {
+    cal = datetime->cal_pool[i];
+    if (cal != NULL && gtk_widget_get_parent(cal) != NULL)
+      gtk_container_remove(GTK_CONTAINER(gtk_widget_get_parent(cal)), cal);
+    datetime->cal_slots[i] = NULL;
+  }
+  if (datetime->cal_adjustment != NULL)
+  {
+    g_signal_handlers_disconnect_by_data(datetime->cal_adjustment, datetime);
+    datetime->cal_adjustment = NULL;
+  }
+  if (datetime->cal_visible_id != 0)
+  {
+    g_source_remove(datetime->cal_visible_id);
+    datetime->cal_visible_id = 0;
+  }
+
   gtk_widget_destroy(datetime->cal);
   datetime->cal = NULL;
+  datetime_refresh_interval(datetime);
 
   xfce_panel_plugin_block_autohide (XFCE_PANEL_PLUGIN (datetime->plugin), FALSE);
   gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(datetime->button), FALSE);
@@ -258,6 +1206,254 @@ static gboolean close_calendar_window(t_datetime *datetime)
   return TRUE;
 }
 
+/*
+ * Number of months shown at once by a calendar view
+ */
+static gint datetime_calendar_view_months(t_calendar_view view)
+{
+  switch(view)
+  {
+    case CALENDAR_VIEW_THREE_MONTHS:
+      return 3;
+    case CALENDAR_VIEW_YEAR:
+      return 12;
+    default:
+      return 1;
+  }
+}
+
+/*
+ * Bitmask of the days to mark in a month.
+ * Computed once per month and cached until the day changes.
+ */
+static guint32 datetime_calendar_marks(t_datetime *datetime, gint month)
+{
+  gpointer marks;
+  struct tm today;
+  gint today_key;
+
+  datetime_localtime(datetime, time(NULL), &today);
+  today_key = (today.tm_year + 1900) * 1000 + today.tm_yday;
+
+  if (datetime->cal_marks == NULL || datetime->cal_today != today_key)
+  {
+    if (datetime->cal_marks != NULL)
+      g_hash_table_destroy(datetime->cal_marks);
+    datetime->cal_marks = g_hash_table_new(NULL, NULL);
+    datetime->cal_today = today_key;
+  }
+
+  if (!g_hash_table_lookup_extended(datetime->cal_marks,
+                                    GINT_TO_POINTER(month), NULL, &marks))
+  {
+    marks = GUINT_TO_POINTER(0);
+    if ((today.tm_year + 1900) * 12 + today.tm_mon == month)
+      marks = GUINT_TO_POINTER(1u << (today.tm_mday - 1));
+    g_hash_table_insert(datetime->cal_marks, GINT_TO_POINTER(month), marks);
+  }
+
+  return GPOINTER_TO_UINT(marks);
+}
+
+/*
+ * Show the month of a place in its calendar, with the marked days selected.
+ */
+static void datetime_calendar_set_month(t_datetime *datetime, gint slot)
+{
+  GtkWidget *cal = datetime->cal_pool[slot];
+  gint month = datetime->cal_first_month + slot;
+  guint32 marks;
+  gint day;
+
+  gtk_calendar_select_month(GTK_CALENDAR(cal), month % 12, month / 12);
+  gtk_calendar_select_day(GTK_CALENDAR(cal), 0);
+  gtk_calendar_clear_marks(GTK_CALENDAR(cal));
+
+  marks = datetime_calendar_marks(datetime, month);
+  for (day = 1; marks != 0; day++, marks >>= 1)
+  {
+    if (marks & 1)
+    {
+      gtk_calendar_mark_day(GTK_CALENDAR(cal), day);
+      gtk_calendar_select_day(GTK_CALENDAR(cal), day);
+    }
+  }
+}
+
+/*
+ * Put the calendar of a place into it, building the calendar the first time.
+ */
+static void datetime_calendar_attach(t_datetime *datetime, gint slot)
+{
+  GtkWidget *cal = datetime->cal_pool[slot];
+
+  if (cal == NULL)
+  {
+    cal = gtk_calendar_new();
+    gtk_calendar_set_display_options(GTK_CALENDAR(cal),
+                                     GTK_CALENDAR_SHOW_HEADING |
+                                     GTK_CALENDAR_SHOW_WEEK_NUMBERS |
+                                     GTK_CALENDAR_SHOW_DAY_NAMES |
+                                     GTK_CALENDAR_NO_MONTH_CHANGE);
+    datetime->cal_pool[slot] = g_object_ref_sink(cal);
+  }
+
+  datetime_calendar_set_month(datetime, slot);
+  gtk_container_add(GTK_CONTAINER(datetime->cal_slots[slot]), cal);
+  gtk_widget_show(cal);
+}
+
+/*
+ * Attach the calendars of the places scrolled into view.
+ */
+static gboolean datetime_calendar_show_visible(t_datetime *datetime)
+{
+  GtkAllocation allocation;
+  gdouble top = gtk_adjustment_get_value(datetime->cal_adjustment);
+  gdouble bottom = top + gtk_adjustment_get_page_size(datetime->cal_adjustment);
+  gint slot;
+
+  for (slot = 0; slot < DATETIME_CALENDAR_MONTHS; slot++)
+  {
+    if (datetime->cal_slots[slot] == NULL ||
+        gtk_bin_get_child(GTK_BIN(datetime->cal_slots[slot])) != NULL)
+      continue;
+
+    gtk_widget_get_allocation(datetime->cal_slots[slot], &allocation);
+    if (allocation.y < bottom && allocation.y + allocation.height > top)
+      datetime_calendar_attach(datetime, slot);
+  }
+
+  datetime->cal_visible_id = 0;
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * The grid was scrolled or laid out; the places in view are known once the
+ * allocation is done, so the calendars are attached after it.
+ */
+static void datetime_calendar_queue_visible(t_datetime *datetime)
+{
+  if (datetime->cal_visible_id == 0)
+    datetime->cal_visible_id = g_idle_add_full(G_PRIORITY_HIGH_IDLE,
+        (GSourceFunc) datetime_calendar_show_visible, datetime, NULL);
+}
+
+/*
+ * Show the visible months in the calendars built so far, starting at
+ * cal_first_month. Calendars are only reconfigured while scrolling.
+ */
+static void datetime_calendar_fill(t_datetime *datetime)
+{
+  gint slot;
+
+  for (slot = 0; slot < DATETIME_CALENDAR_MONTHS; slot++)
+    if (datetime->cal_slots[slot] != NULL &&
+        gtk_bin_get_child(GTK_BIN(datetime->cal_slots[slot])) != NULL)
+      datetime_calendar_set_month(datetime, slot);
+}
+
+/*
+ * scrolling over a multi-month calendar moves by a month, or by a year
+ */
+static gboolean datetime_calendar_scrolled(GtkWidget *widget,
+                                           GdkEventScroll *event,
+                                           t_datetime *datetime)
+{
+  gint step = (datetime->calendar_view == CALENDAR_VIEW_YEAR) ? 12 : 1;
+  gdouble dx, dy;
+
+  switch(event->direction)
+  {
+    case GDK_SCROLL_UP:
+    case GDK_SCROLL_LEFT:
+      step = -step;
+      break;
+    case GDK_SCROLL_SMOOTH:
+      gdk_event_get_scroll_deltas((GdkEvent *) event, &dx, &dy);
+      if (dy == 0)
+        return FALSE;
+      if (dy < 0)
+        step = -step;
+      break;
+    default:
+      break;
+  }
+
+  datetime->cal_first_month += step;
+  datetime_calendar_fill(datetime);
+
+  return TRUE;
+}
+
+/*
+ * Grid of calendars for the three month and year views.
+ * The grid scrolls when it is higher than the monitor, and the calendars of
+ * the months out of view are built once they are scrolled to.
+ */
+static GtkWidget * datetime_calendar_grid_new(t_datetime *datetime)
+{
+  GtkWidget *scrolled;
+  GtkWidget *grid;
+  GtkWidget *slot;
+  GtkRequisition size;
+  GdkRectangle workarea;
+  GdkMonitor *monitor;
+  struct tm today;
+  gint months = datetime_calendar_view_months(datetime->calendar_view);
+  gint columns = (months == 12) ? 4 : months;
+  gint i;
+
+  /* the current month comes second in the three month view */
+  datetime_localtime(datetime, time(NULL), &today);
+  datetime->cal_first_month = (today.tm_year + 1900) * 12;
+  if (datetime->calendar_view == CALENDAR_VIEW_THREE_MONTHS)
+    datetime->cal_first_month += today.tm_mon - 1;
+
+  grid = gtk_grid_new();
+  gtk_grid_set_row_spacing(GTK_GRID(grid), 6);
+  gtk_grid_set_column_spacing(GTK_GRID(grid), 6);
+  for (i = 0; i < months; i++)
+  {
+    slot = gtk_frame_new(NULL);
+    gtk_frame_set_shadow_type(GTK_FRAME(slot), GTK_SHADOW_NONE);
+    gtk_grid_attach(GTK_GRID(grid), slot, i % columns, i / columns, 1, 1);
+    datetime->cal_slots[i] = slot;
+  }
+
+  /* the first calendar is always in view; the others take its size */
+  datetime_calendar_attach(datetime, 0);
+  gtk_widget_get_preferred_size(datetime->cal_pool[0], NULL, &size);
+  for (i = 1; i < months; i++)
+    gtk_widget_set_size_request(datetime->cal_slots[i], size.width, size.height);
+
+  scrolled = gtk_scrolled_window_new(NULL, NULL);
+  gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
+                                 GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+  gtk_scrolled_window_set_propagate_natural_width(GTK_SCROLLED_WINDOW(scrolled), TRUE);
+  gtk_scrolled_window_set_propagate_natural_height(GTK_SCROLLED_WINDOW(scrolled), TRUE);
+  monitor = gdk_display_get_monitor_at_window(gtk_widget_get_display(datetime->button),
+      gtk_widget_get_window(datetime->button));
+  if (monitor != NULL)
+  {
+    gdk_monitor_get_workarea(monitor, &workarea);
+    gtk_scrolled_window_set_max_content_height(GTK_SCROLLED_WINDOW(scrolled),
+                                               workarea.height);
+  }
+  gtk_container_add(GTK_CONTAINER(scrolled), grid);
+
+  datetime->cal_adjustment =
+    gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(scrolled));
+  g_signal_connect_swapped(datetime->cal_adjustment, "value-changed",
+      G_CALLBACK(datetime_calendar_queue_visible), datetime);
+  g_signal_connect_data(grid, "size-allocate",
+      G_CALLBACK(datetime_calendar_queue_visible), datetime, NULL,
+      G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+
+  return scrolled;
+}
+
 /*
  * call the gtk calendar
  */
@@ -268,6 +1464,8 @@ static GtkWidget * pop_calendar_window(t_datetime *datetime, int orientation)
   GtkWidget  *parent = datetime->button;
   GdkScreen  *screen;
   GtkCalendarDisplayOptions display_options;
+  struct tm today;
+  gint64 trace_time = datetime_trace_begin();
 
   window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
   gtk_window_set_decorated(GTK_WINDOW(window), FALSE);
@@ -280,11 +1478,30 @@ static GtkWidget * pop_calendar_window(t_datetime *datetime, int orientation)
   screen = gtk_widget_get_screen(parent);
   gtk_window_set_screen(GTK_WINDOW(window), screen);
 
-  cal = gtk_calendar_new();
-  display_options = GTK_CALENDAR_SHOW_HEADING |
-    GTK_CALENDAR_SHOW_WEEK_NUMBERS |
-    GTK_CALENDAR_SHOW_DAY_NAMES;
-  gtk_calendar_set_display_options(GTK_CALENDAR (cal), display_options);
+  if (datetime->calendar_view == CALENDAR_VIEW_MONTH)
+  {
+    cal = gtk_calendar_new();
+    display_options = GTK_CALENDAR_SHOW_HEADING |
+      GTK_CALENDAR_SHOW_WEEK_NUMBERS |
+      GTK_CALENDAR_SHOW_DAY_NAMES;
+    gtk_calendar_set_display_options(GTK_CALENDAR (cal), display_options);
+
+    /* the calendar selects the local date by itself */
+    if (datetime->tz != NULL)
+    {
+      datetime_localtime(datetime, time(NULL), &today);
+      gtk_calendar_select_month(GTK_CALENDAR(cal), today.tm_mon, today.tm_year + 1900);
+      gtk_calendar_select_day(GTK_CALENDAR(cal), today.tm_mday);
+    }
+  }
+  else
+  {
+    cal = datetime_calendar_grid_new(datetime);
+    gtk_widget_add_events(window, GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK);
+    g_signal_connect(G_OBJECT(window), "scroll-event",
+        G_CALLBACK(datetime_calendar_scrolled),
+        datetime);
+  }
   gtk_container_add (GTK_CONTAINER(window), cal);
 
   g_signal_connect_after(G_OBJECT(window), "realize",
@@ -301,6 +1518,8 @@ static GtkWidget * pop_calendar_window(t_datetime *datetime, int orientation)
   xfce_panel_plugin_block_autohide (XFCE_PANEL_PLUGIN (datetime->plugin), TRUE);
   gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(datetime->button), TRUE);
 
+  datetime_trace_end(trace_time, "popup");
+
   return window;
 }
 
@@ -312,6 +1531,7 @@ static gboolean datetime_clicked(GtkWidget *widget,
     t_datetime *datetime)
 {
   gint orientation;
+  gint64 start_time;
 
   if (event->button != 1 || event->state & GDK_CONTROL_MASK)
     return FALSE;
@@ -329,20 +1549,27 @@ static gboolean datetime_clicked(GtkWidget *widget,
     orientation = xfce_panel_plugin_get_orientation(datetime->plugin);
 
     /* draw calendar */
+    start_time = g_get_monotonic_time();
     datetime->cal = pop_calendar_window(datetime,
                                         orientation);
+    datetime_refresh_interval(datetime);
+    datetime_report_timing("popup", start_time);
   }
   return TRUE;
 }
 
-static void datetime_update_date_font(t_datetime *datetime)
+/*
+ * set the font of a label
+ */
+static void datetime_update_label_font(GtkWidget *label, const gchar *font_name)
 {
+  gint64 trace_time = datetime_trace_begin();
 #if GTK_CHECK_VERSION (3, 16, 0)
     GtkCssProvider *css_provider;
     gchar * css;
 #if GTK_CHECK_VERSION (3, 20, 0)
   PangoFontDescription *font;
-  font = pango_font_description_from_string(datetime->date_font);
+  font = pango_font_description_from_string(font_name);
   if (G_LIKELY (font))
   {
     css = g_strdup_printf("label { font-family: %s; font-size: %dpt; font-style: %s; font-weight: %s }",
@@ -358,142 +1585,345 @@ static void datetime_update_date_font(t_datetime *datetime)
 #else
     css = g_strdup_printf(".label { font: %s; }",
 #endif
-                          datetime->date_font);
-    /* Setup Gtk style */
+                          font_name);
+    /* Setup Gtk style, reusing the provider of the label */
     DBG("css: %s",css);
-    css_provider = gtk_css_provider_new ();
+    css_provider = g_object_get_data(G_OBJECT(label), "datetime-css-provider");
+    if (css_provider == NULL)
+    {
+      css_provider = gtk_css_provider_new ();
+      gtk_style_context_add_provider (
+          GTK_STYLE_CONTEXT (gtk_widget_get_style_context (GTK_WIDGET (label))),
+          GTK_STYLE_PROVIDER (css_provider),
+          GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+      g_object_set_data_full(G_OBJECT(label), "datetime-css-provider",
+                             css_provider, g_object_unref);
+    }
     gtk_css_provider_load_from_data (css_provider, css, strlen(css), NULL);
-    gtk_style_context_add_provider (
-        GTK_STYLE_CONTEXT (gtk_widget_get_style_context (GTK_WIDGET (datetime->date_label))),
-        GTK_STYLE_PROVIDER (css_provider),
-        GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
     g_free(css);
 #else
   PangoFontDescription *font;
-  font = pango_font_description_from_string(datetime->date_font);
+  font = pango_font_description_from_string(font_name);
 
   if (G_LIKELY (font))
   {
-    gtk_widget_override_font(datetime->date_label, font);
+    gtk_widget_override_font(label, font);
     pango_font_description_free (font);
   }
 #endif
+
+  datetime_trace_end(trace_time, "font");
 }
 
-static void datetime_update_time_font(t_datetime *datetime)
+/*
+ * Replace a font by the installed one it resolves to, so that neither
+ * the style nor the layouts leave the choice to fontconfig every time
+ */
+static void datetime_resolve_font(GtkWidget *label,
+    const gchar *font_name,
+    gchar **match)
+{
+  g_free(*match);
+  *match = g_strdup(datetime_font_resolve(label, font_name)->font);
+}
+
+/*
+ * Get a font with its size changed by delta points
+ */
+static gchar * datetime_fit_font(const gchar *font_name, gint delta)
 {
-#if GTK_CHECK_VERSION (3, 16, 0)
-    GtkCssProvider *css_provider;
-    gchar * css;
-#if GTK_CHECK_VERSION (3, 20, 0)
   PangoFontDescription *font;
-  font = pango_font_description_from_string(datetime->time_font);
-  if (G_LIKELY (font))
+  gchar *fitted;
+  gint size;
+
+  font = pango_font_description_from_string(font_name);
+  size = pango_font_description_get_size(font) / PANGO_SCALE + delta;
+  pango_font_description_set_size(font, MAX(size, 1) * PANGO_SCALE);
+  fitted = pango_font_description_to_string(font);
+  pango_font_description_free(font);
+
+  return fitted;
+}
+
+/*
+ * Set a label's font unless it already has it
+ */
+static void datetime_set_fit_font(GtkWidget *label,
+    gchar **fit_font,
+    gchar *fitted,
+    const gchar *font_name)
+{
+  if (fitted != NULL && g_strcmp0(fitted, *fit_font) == 0)
   {
-    css = g_strdup_printf("label { font-family: %s; font-size: %dpt; font-style: %s; font-weight: %s }",
-                          pango_font_description_get_family (font),
-                          pango_font_description_get_size (font) / PANGO_SCALE,
-                          (pango_font_description_get_style(font) == PANGO_STYLE_ITALIC ||
-                           pango_font_description_get_style(font) == PANGO_STYLE_OBLIQUE) ? "italic" : "normal",
-                          (pango_font_description_get_weight(font) >= PANGO_WEIGHT_BOLD) ? "bold" : "normal");
-    pango_font_description_free (font);
+    g_free(fitted);
+    return;
   }
-  else
-    css = g_strdup_printf("label { font: %s; }",
-#else
-    css = g_strdup_printf(".label { font: %s; }",
-#endif
-                          datetime->time_font);
-    /* Setup Gtk style */
-    DBG("css: %s",css);
-    css_provider = gtk_css_provider_new ();
-    gtk_css_provider_load_from_data (css_provider, css, strlen(css), NULL);
-    gtk_style_context_add_provider (
-        GTK_STYLE_CONTEXT (gtk_widget_get_style_context (GTK_WIDGET (datetime->time_label))),
-        GTK_STYLE_PROVIDER (css_provider),
-        GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-    g_free(css);
-#else
-  PangoFontDescription *font;
-  font = pango_font_description_from_string(datetime->time_font);
 
-  if (G_LIKELY (font))
+  g_free(*fit_font);
+  *fit_font = fitted;
+  datetime_update_label_font(label, fitted != NULL ? fitted : font_name);
+}
+
+/*
+ * Segments turned by their own angle lie across the lines and are left
+ * out of the fit, the others are lines like the date and time
+ */
+static inline gboolean datetime_segment_fits(t_segment *segment)
+{
+  return segment->angle == 0;
+}
+
+/*
+ * Font of a segment before it is fitted: its own one or the font the
+ * labels inherit from the button
+ */
+static gchar * datetime_segment_font(t_datetime *datetime, t_segment *segment)
+{
+  if (segment->font != NULL)
+    return g_strdup(datetime_font_resolve(segment->label, segment->font)->font);
+
+  return pango_font_description_to_string(
+      pango_context_get_font_description(gtk_widget_get_pango_context(datetime->button)));
+}
+
+/*
+ * Give the segments their configured fonts back
+ */
+static void datetime_unfit_segments(t_datetime *datetime)
+{
+  t_segment *segment;
+  gchar *font;
+  guint i;
+
+  for (i = 0; i < datetime->segments->len; i++)
+  {
+    segment = g_ptr_array_index(datetime->segments, i);
+    if (segment->fit_font == NULL)
+      continue;
+
+    font = datetime_segment_font(datetime, segment);
+    datetime_set_fit_font(segment->label, &segment->fit_font, NULL, font);
+    g_free(font);
+  }
+}
+
+/*
+ * Resize the fonts of the shown lines together, keeping the difference
+ * of their sizes, so that the lines fill the height of a panel row.
+ * Labels are only restyled when a fitted size changes, so that dragging
+ * the panel size is cheap.
+ */
+static void datetime_fit_fonts(t_datetime *datetime, gboolean force)
+{
+  PangoFontDescription **fonts;
+  t_segment *segment;
+  guint n_fonts = 0;
+  gchar *font;
+  gint delta;
+  guint i;
+
+  if (force || !datetime->auto_fit)
+  {
+    g_free(datetime->date_fit_font);
+    g_free(datetime->time_fit_font);
+    datetime->date_fit_font = NULL;
+    datetime->time_fit_font = NULL;
+    datetime->fit_row_size = 0;
+    datetime_unfit_segments(datetime);
+  }
+
+  if (!datetime->auto_fit || datetime->row_size <= 0)
+    return;
+
+  /* e.g. the fonts of the snapshot, restored before the panel set the size */
+  if (datetime->row_size == datetime->fit_row_size)
+    return;
+
+  fonts = g_newa(PangoFontDescription *, 2 + datetime->segments->len);
+  if (datetime_shows_date(datetime))
+    fonts[n_fonts++] = pango_font_description_from_string(datetime->date_match);
+  if (datetime_shows_time(datetime))
+    fonts[n_fonts++] = pango_font_description_from_string(datetime->time_match);
+
+  /* the segments are lines of the same row */
+  for (i = 0; i < datetime->segments->len; i++)
+  {
+    segment = g_ptr_array_index(datetime->segments, i);
+    if (!datetime_segment_fits(segment))
+      continue;
+
+    font = datetime_segment_font(datetime, segment);
+    fonts[n_fonts++] = pango_font_description_from_string(font);
+    g_free(font);
+  }
+
+  delta = datetime_fit_delta(datetime->date_label, fonts, n_fonts,
+                             datetime->row_size);
+  while (n_fonts > 0)
+    pango_font_description_free(fonts[--n_fonts]);
+
+  datetime_set_fit_font(datetime->date_label, &datetime->date_fit_font,
+                        datetime_fit_font(datetime->date_match, delta),
+                        datetime->date_match);
+  datetime_set_fit_font(datetime->time_label, &datetime->time_fit_font,
+                        datetime_fit_font(datetime->time_match, delta),
+                        datetime->time_match);
+  for (i = 0; i < datetime->segments->len; i++)
+  {
+    segment = g_ptr_array_index(datetime->segments, i);
+    if (!datetime_segment_fits(segment))
+      continue;
+
+    font = datetime_segment_font(datetime, segment);
+    datetime_set_fit_font(segment->label, &segment->fit_font,
+                          datetime_fit_font(font, delta), font);
+    g_free(font);
+  }
+  datetime->fit_row_size = datetime->row_size;
+
+  if (datetime->rotated)
+    datetime_update_rotated(datetime);
+}
+
+/*
+ * Hash of everything the row size and the fitted fonts depend on
+ */
+static gchar * datetime_snapshot_config(t_datetime *datetime)
+{
+  gchar *theme = NULL;
+  gchar *description;
+  gchar *config;
+
+  g_object_get(gtk_widget_get_settings(datetime->button),
+               "gtk-theme-name", &theme, NULL);
+  description = g_strdup_printf("%d %d %d %d %d %g\n%s\n%s\n%s",
+      datetime->layout, datetime->auto_fit, datetime->vertical,
+      xfce_panel_plugin_get_size(datetime->plugin),
+      xfce_panel_plugin_get_nrows(datetime->plugin),
+      gdk_screen_get_resolution(gtk_widget_get_screen(datetime->button)),
+      theme, datetime->date_match, datetime->time_match);
+  config = g_compute_checksum_for_string(G_CHECKSUM_SHA1, description, -1);
+  g_free(description);
+  g_free(theme);
+
+  return config;
+}
+
+/* the snapshot file is named after the plugin, e.g. datetime-12 */
+static gchar * datetime_snapshot_name(t_datetime *datetime)
+{
+  return g_strdup_printf("%s-%d", xfce_panel_plugin_get_name(datetime->plugin),
+                         xfce_panel_plugin_get_unique_id(datetime->plugin));
+}
+
+/*
+ * Before the panel sets the size, lay out with the row size and the fitted
+ * fonts of the last run, so that the first layout is the final one and the
+ * fonts need not be measured again.
+ */
+static void datetime_restore_snapshot(t_datetime *datetime)
+{
+  gchar *name = datetime_snapshot_name(datetime);
+  gchar *config = datetime_snapshot_config(datetime);
+
+  datetime->snapshot = datetime_snapshot_load(name, config);
+  g_free(config);
+  g_free(name);
+  if (datetime->snapshot == NULL)
+    return;
+
+  datetime->row_size = datetime->snapshot->row_size;
+  gtk_widget_set_size_request(datetime->analog_area,
+                              datetime->row_size, datetime->row_size);
+
+  if (datetime->auto_fit)
   {
-    gtk_widget_override_font(datetime->time_label, font);
-    pango_font_description_free (font);
+    datetime_set_fit_font(datetime->date_label, &datetime->date_fit_font,
+                          g_strdup(datetime->snapshot->date_font),
+                          datetime->date_match);
+    datetime_set_fit_font(datetime->time_label, &datetime->time_fit_font,
+                          g_strdup(datetime->snapshot->time_font),
+                          datetime->time_match);
+
+    /* the snapshot has no fonts of segments, which are fitted on the size */
+    if (datetime->segments->len == 0)
+      datetime->fit_row_size = datetime->row_size;
+
+    if (datetime->rotated)
+      datetime_update_rotated(datetime);
   }
-#endif
 }
 
-static void datetime_set_update_interval(t_datetime *datetime)
+/*
+ * Save the layout unless it is the saved one
+ */
+static gboolean datetime_save_snapshot(t_datetime *datetime)
 {
-  /* a custom date format could specify seconds */
-  gboolean date_has_seconds = datetime_format_has_seconds(datetime->date_format);
-  gboolean time_has_seconds = datetime_format_has_seconds(datetime->time_format);
-  gboolean has_seconds;
+  t_render_snapshot *snapshot;
+  gchar *name;
 
-  /* set update interval for the date/time displayed in the panel */
-  switch(datetime->layout)
+  if (datetime->row_size <= 0)
+    return G_SOURCE_CONTINUE;
+
+  snapshot = g_slice_new0(t_render_snapshot);
+  snapshot->config = datetime_snapshot_config(datetime);
+  snapshot->row_size = datetime->row_size;
+  snapshot->date_font = g_strdup(datetime->date_fit_font);
+  snapshot->time_font = g_strdup(datetime->time_fit_font);
+
+  if (datetime_snapshot_equal(snapshot, datetime->snapshot))
   {
-    case LAYOUT_DATE:
-      has_seconds = date_has_seconds;
-      break;
-    case LAYOUT_TIME:
-      has_seconds = time_has_seconds;
-      break;
-    default:
-      has_seconds = date_has_seconds || time_has_seconds;
-      break;
+    datetime_snapshot_free(snapshot);
+    return G_SOURCE_CONTINUE;
   }
 
-  /* 1000 ms in 1 second */
-  datetime->update_interval = 1000 * (has_seconds ? 1 : 60);
+  name = datetime_snapshot_name(datetime);
+  datetime_snapshot_save(name, snapshot);
+  g_free(name);
+
+  datetime_snapshot_free(datetime->snapshot);
+  datetime->snapshot = snapshot;
+
+  return G_SOURCE_CONTINUE;
 }
 
 /*
- * set layout after doing some checks
+ * Dragging the panel size changes the layout many times,
+ * so it is saved once it settled.
  */
-void datetime_apply_layout(t_datetime *datetime, t_layout layout)
+static void datetime_schedule_snapshot(t_datetime *datetime)
 {
-  if(layout < LAYOUT_COUNT)
-  {
-    datetime->layout = layout;
-  }
+  if (datetime->snapshot_source != NULL)
+    g_source_set_ready_time(datetime->snapshot_source,
+        g_get_monotonic_time() + DATETIME_SNAPSHOT_DELAY * 1000);
+}
+
+/*
+ * show the labels, the tooltip and the order of the lines for the layout
+ */
+static void datetime_commit_layout(t_datetime *datetime)
+{
+  gboolean has_tooltip;
 
   /* hide labels based on layout-selection */
-  gtk_widget_show(GTK_WIDGET(datetime->time_label));
-  gtk_widget_show(GTK_WIDGET(datetime->date_label));
-  switch(datetime->layout)
+  datetime_show_labels(datetime);
+
+  /* the tooltip shows what the panel does not */
+  has_tooltip = (datetime->layout == LAYOUT_DATE || datetime->layout == LAYOUT_TIME ||
+                 datetime->layout == LAYOUT_ANALOG);
+  if (has_tooltip && datetime->tooltip_handler_id == 0)
   {
-    case LAYOUT_DATE:
-      gtk_widget_hide(GTK_WIDGET(datetime->time_label));
-      break;
-    case LAYOUT_TIME:
-      gtk_widget_hide(GTK_WIDGET(datetime->date_label));
-      break;
-    default:
-      break;
+    gtk_widget_set_has_tooltip(GTK_WIDGET(datetime->button), TRUE);
+    datetime->tooltip_handler_id = g_signal_connect(datetime->button,
+                           "query-tooltip",
+                           G_CALLBACK(datetime_query_tooltip), datetime);
   }
-
-  /* update tooltip handler */
-  if (datetime->tooltip_handler_id)
+  else if (!has_tooltip && datetime->tooltip_handler_id != 0)
   {
     g_signal_handler_disconnect(datetime->button,
                                 datetime->tooltip_handler_id);
     datetime->tooltip_handler_id = 0;
-  }
-  switch(datetime->layout)
-  {
-    case LAYOUT_DATE:
-    case LAYOUT_TIME:
-      gtk_widget_set_has_tooltip(GTK_WIDGET(datetime->button), TRUE);
-      datetime->tooltip_handler_id = g_signal_connect(datetime->button,
-                             "query-tooltip",
-                             G_CALLBACK(datetime_query_tooltip), datetime);
-      break;
-
-    default:
-      gtk_widget_set_has_tooltip(GTK_WIDGET(datetime->button), FALSE);
+    gtk_widget_set_has_tooltip(GTK_WIDGET(datetime->button), FALSE);
   }
 
   /* set order based on layout-selection */
@@ -508,8 +1938,119 @@ void datetime_apply_layout(t_datetime *datetime, t_layout layout)
       gtk_box_reorder_child(GTK_BOX(datetime->box), datetime->time_label, 1);
       gtk_box_reorder_child(GTK_BOX(datetime->box), datetime->date_label, 0);
   }
+}
 
-  datetime_set_update_interval(datetime);
+/*
+ * Recompute everything the collected changes affect, once.
+ */
+static void datetime_apply_commit(t_datetime *datetime)
+{
+  guint pending = datetime->apply_pending;
+  gint64 trace_time = datetime_trace_begin();
+
+  datetime->apply_pending = 0;
+
+  if (pending & DATETIME_APPLY_DATE_FONT)
+  {
+    datetime_resolve_font(datetime->date_label, datetime->date_font,
+                          &datetime->date_match);
+    datetime_update_label_font(datetime->date_label, datetime->date_match);
+  }
+
+  if (pending & DATETIME_APPLY_TIME_FONT)
+  {
+    datetime_resolve_font(datetime->time_label, datetime->time_font,
+                          &datetime->time_match);
+    datetime_update_label_font(datetime->time_label, datetime->time_match);
+  }
+
+  if (pending & DATETIME_APPLY_LAYOUT)
+    datetime_commit_layout(datetime);
+
+  /* the shown lines share the panel row */
+  if (pending & (DATETIME_APPLY_LAYOUT | DATETIME_APPLY_DATE_FONT | DATETIME_APPLY_TIME_FONT))
+  {
+    datetime_fit_fonts(datetime, TRUE);
+    datetime_schedule_snapshot(datetime);
+  }
+
+  if (pending & (DATETIME_APPLY_LAYOUT | DATETIME_APPLY_FORMAT | DATETIME_APPLY_INTERVAL))
+  {
+    /* render once with the new settings, which also updates rotated text */
+    datetime_set_update_interval(datetime);
+    datetime_update(datetime);
+  }
+  else if (datetime->rotated)
+    datetime_update_rotated(datetime);
+
+  datetime_trace_end(trace_time, "apply");
+}
+
+/*
+ * Collect the changes of the following datetime_apply_*() calls,
+ * so that datetime_apply_end() relayouts and renders only once.
+ */
+void datetime_apply_begin(t_datetime *datetime)
+{
+  /* strings prepared with the old settings are not shown */
+  if (datetime->apply_depth++ == 0)
+    datetime_discard_prerender(datetime);
+}
+
+void datetime_apply_end(t_datetime *datetime)
+{
+  g_return_if_fail(datetime->apply_depth > 0);
+
+  if (--datetime->apply_depth == 0 && datetime->apply_pending != 0)
+    datetime_apply_commit(datetime);
+}
+
+/*
+ * Single changes outside of a batch are committed right away
+ */
+static void datetime_apply_changed(t_datetime *datetime, guint changes)
+{
+  datetime->apply_pending |= changes;
+
+  if (datetime->apply_depth == 0)
+    datetime_apply_commit(datetime);
+}
+
+/*
+ * Fonts were installed or removed, or fontconfig was configured anew
+ */
+static void datetime_fonts_changed(t_datetime *datetime)
+{
+  t_segment *segment;
+  guint i;
+
+  datetime_font_flush();
+
+  for (i = 0; i < datetime->segments->len; i++)
+  {
+    segment = g_ptr_array_index(datetime->segments, i);
+    if (segment->font != NULL)
+      datetime_update_label_font(segment->label,
+          datetime_font_resolve(segment->label, segment->font)->font);
+  }
+
+  datetime_apply_changed(datetime,
+                         DATETIME_APPLY_DATE_FONT | DATETIME_APPLY_TIME_FONT);
+  datetime_dialog_refresh(datetime);
+}
+
+/*
+ * set layout after doing some checks
+ */
+void datetime_apply_layout(t_datetime *datetime, t_layout layout)
+{
+  if (layout < LAYOUT_COUNT && layout != datetime->layout)
+  {
+    datetime_apply_begin(datetime);
+    datetime->layout = layout;
+    datetime_apply_changed(datetime, DATETIME_APPLY_LAYOUT);
+    datetime_apply_end(datetime);
+  }
 }
 
 /*
@@ -519,19 +2060,43 @@ void datetime_apply_font(t_datetime *datetime,
     const gchar *date_font_name,
     const gchar *time_font_name)
 {
-  if (date_font_name != NULL)
+  guint changes = 0;
+
+  if (date_font_name != NULL && g_strcmp0(date_font_name, datetime->date_font) != 0)
   {
     g_free(datetime->date_font);
     datetime->date_font = g_strdup(date_font_name);
-    datetime_update_date_font(datetime);
+    changes |= DATETIME_APPLY_DATE_FONT;
   }
 
-  if (time_font_name != NULL)
+  if (time_font_name != NULL && g_strcmp0(time_font_name, datetime->time_font) != 0)
   {
     g_free(datetime->time_font);
     datetime->time_font = g_strdup(time_font_name);
-    datetime_update_time_font(datetime);
+    changes |= DATETIME_APPLY_TIME_FONT;
   }
+
+  if (changes != 0)
+    datetime_apply_changed(datetime, changes);
+}
+
+/*
+ * parse the markup of a format once, instead of on every update
+ */
+static void datetime_set_markup(t_datetime_text *text,
+    GtkWidget *label,
+    const gchar *format)
+{
+  datetime_markup_free(text->markup);
+  text->markup = datetime_markup_new(format);
+  datetime_format_free(text->compiled);
+  text->compiled = datetime_format_new(text->markup != NULL ?
+      datetime_markup_get_format(text->markup) : format);
+  datetime_reset_table(text);
+
+  /* attributes are set with the next text */
+  if (text->markup == NULL)
+    gtk_label_set_attributes(GTK_LABEL(label), NULL);
 }
 
 /*
@@ -541,22 +2106,236 @@ void datetime_apply_format(t_datetime *datetime,
     const gchar *date_format,
     const gchar *time_format)
 {
+  guint changes = 0;
+
   if (datetime == NULL)
     return;
 
-  if (date_format != NULL)
+  datetime_apply_begin(datetime);
+
+  if (date_format != NULL && g_strcmp0(date_format, datetime->date_format) != 0)
   {
     g_free(datetime->date_format);
     datetime->date_format = g_strdup(date_format);
+    datetime_set_markup(&datetime->date_text, datetime->date_label, date_format);
+    changes |= DATETIME_APPLY_FORMAT;
   }
 
-  if (time_format != NULL)
+  if (time_format != NULL && g_strcmp0(time_format, datetime->time_format) != 0)
   {
     g_free(datetime->time_format);
     datetime->time_format = g_strdup(time_format);
+    datetime_set_markup(&datetime->time_text, datetime->time_label, time_format);
+    changes |= DATETIME_APPLY_FORMAT;
   }
 
-  datetime_set_update_interval(datetime);
+  if (changes != 0)
+    datetime_apply_changed(datetime, changes);
+  datetime_apply_end(datetime);
+}
+
+/*
+ * set the locales of the date and time, an empty name for the process locale
+ */
+void datetime_apply_locale(t_datetime *datetime,
+    const gchar *date_locale,
+    const gchar *time_locale)
+{
+  guint changes = 0;
+
+  datetime_apply_begin(datetime);
+
+  if (date_locale != NULL && g_strcmp0(date_locale, datetime->date_locale) != 0)
+  {
+    g_free(datetime->date_locale);
+    datetime->date_locale = g_strdup(date_locale);
+    datetime->date_text.locale = datetime_locale_get(date_locale);
+    datetime_reset_table(&datetime->date_text);
+    changes |= DATETIME_APPLY_FORMAT;
+  }
+
+  if (time_locale != NULL && g_strcmp0(time_locale, datetime->time_locale) != 0)
+  {
+    g_free(datetime->time_locale);
+    datetime->time_locale = g_strdup(time_locale);
+    datetime->time_text.locale = datetime_locale_get(time_locale);
+    datetime_reset_table(&datetime->time_text);
+    changes |= DATETIME_APPLY_FORMAT;
+  }
+
+  if (changes != 0)
+    datetime_apply_changed(datetime, changes);
+  datetime_apply_end(datetime);
+}
+
+/*
+ * set the time zone the time is shown in, an empty name for the local time
+ */
+void datetime_apply_timezone(t_datetime *datetime, const gchar *zone)
+{
+  t_segment *segment;
+  guint i;
+
+  if (zone == NULL || g_strcmp0(zone, datetime->timezone) == 0)
+    return;
+
+  datetime_apply_begin(datetime);
+
+  g_free(datetime->timezone);
+  datetime->timezone = g_strdup(zone);
+  if (datetime->tz != NULL)
+    g_time_zone_unref(datetime->tz);
+  datetime->tz = NULL;
+  if (*zone != '\0')
+  {
+    datetime->tz = datetime_zone_new(zone);
+    if (datetime->tz == NULL)
+      g_warning("Time zone %s is not available, the local time is shown", zone);
+  }
+
+  /* the tables hold the strings of the days in the old zone */
+  datetime_reset_table(&datetime->date_text);
+  datetime_reset_table(&datetime->time_text);
+  for (i = 0; i < datetime->segments->len; i++)
+  {
+    segment = g_ptr_array_index(datetime->segments, i);
+    datetime_reset_table(&segment->text);
+  }
+
+  /* the calendar marks today of the old zone */
+  if (datetime->cal_marks != NULL)
+  {
+    g_hash_table_destroy(datetime->cal_marks);
+    datetime->cal_marks = NULL;
+  }
+
+  datetime_apply_changed(datetime, DATETIME_APPLY_FORMAT);
+  datetime_apply_end(datetime);
+}
+
+/*
+ * On vertical panels a segment is turned like the date and time, unless it
+ * has an angle of its own.
+ */
+static gint datetime_segment_angle(t_datetime *datetime, t_segment *segment)
+{
+  return datetime->vertical && segment->angle == 0 ? -90 : segment->angle;
+}
+
+/*
+ * add a line after the date and time, which is updated by the same timer
+ */
+static void datetime_add_segment(t_datetime *datetime,
+    const gchar *format,
+    const gchar *font,
+    const gchar *locale,
+    gint angle)
+{
+  t_segment *segment = g_slice_new0(t_segment);
+
+  segment->format = g_strdup(format);
+  segment->font = g_strdup(font);
+  segment->locale = g_strdup(locale);
+  segment->text.locale = datetime_locale_get(locale);
+  segment->angle = angle;
+  segment->text.period[0] = -1;
+  segment->text.period[1] = -1;
+
+  segment->rotated = datetime_rotated_line_new();
+  segment->label = gtk_label_new("");
+  gtk_label_set_justify(GTK_LABEL(segment->label), GTK_JUSTIFY_CENTER);
+  gtk_label_set_angle(GTK_LABEL(segment->label),
+                      datetime_segment_angle(datetime, segment));
+  datetime_set_markup(&segment->text, segment->label, format);
+  if (segment->font != NULL)
+    datetime_update_label_font(segment->label,
+        datetime_font_resolve(segment->label, segment->font)->font);
+  gtk_box_pack_start(GTK_BOX(datetime->box), segment->label, TRUE, FALSE, 0);
+  gtk_widget_set_visible(segment->label, !datetime->rotated);
+
+  g_ptr_array_add(datetime->segments, segment);
+  datetime_apply_changed(datetime, DATETIME_APPLY_FORMAT);
+}
+
+static void datetime_segment_free(t_segment *segment)
+{
+  datetime_markup_free(segment->text.markup);
+  datetime_format_free(segment->text.compiled);
+  datetime_string_table_free(segment->text.table);
+  datetime_rotated_line_free(segment->rotated);
+  g_free(segment->format);
+  g_free(segment->font);
+  g_free(segment->fit_font);
+  g_free(segment->locale);
+  g_slice_free(t_segment, segment);
+}
+
+/*
+ * Read the settings of a line after the date and time.
+ * Returns FALSE if it has no format.
+ */
+static gboolean datetime_read_segment(XfceRc *rc,
+    gint i,
+    const gchar **format,
+    const gchar **font,
+    const gchar **locale,
+    gint *angle)
+{
+  gchar key[32];
+
+  g_snprintf(key, sizeof(key), "segment%d_format", i);
+  *format = xfce_rc_read_entry(rc, key, NULL);
+  g_snprintf(key, sizeof(key), "segment%d_font", i);
+  *font = xfce_rc_read_entry(rc, key, NULL);
+  g_snprintf(key, sizeof(key), "segment%d_locale", i);
+  *locale = xfce_rc_read_entry(rc, key, NULL);
+  g_snprintf(key, sizeof(key), "segment%d_angle", i);
+  *angle = xfce_rc_read_int_entry(rc, key, 0);
+
+  return *format != NULL;
+}
+
+/*
+ * Read the further lines, e.g. a week number or another format of the time.
+ * The lines are only built again if one of them changed, so that reloading
+ * the rc file leaves them alone otherwise.
+ */
+static void datetime_read_segments(t_datetime *datetime, XfceRc *rc)
+{
+  t_segment *segment;
+  const gchar *format, *font, *locale;
+  gint segments, angle, i;
+  gboolean changed;
+
+  segments = rc != NULL ? MAX(xfce_rc_read_int_entry(rc, "segments", 0), 0) : 0;
+
+  changed = (guint) segments != datetime->segments->len;
+  for (i = 0; !changed && i < segments; i++)
+  {
+    segment = g_ptr_array_index(datetime->segments, i);
+    changed = !datetime_read_segment(rc, i, &format, &font, &locale, &angle) ||
+              strcmp(format, segment->format) != 0 ||
+              g_strcmp0(font, segment->font) != 0 ||
+              g_strcmp0(locale, segment->locale) != 0 ||
+              angle != segment->angle;
+  }
+
+  if (!changed)
+    return;
+
+  for (i = 0; i < (gint) datetime->segments->len; i++)
+  {
+    segment = g_ptr_array_index(datetime->segments, i);
+    gtk_widget_destroy(segment->label);
+  }
+  g_ptr_array_set_size(datetime->segments, 0);
+  datetime_apply_changed(datetime, DATETIME_APPLY_LAYOUT | DATETIME_APPLY_FORMAT);
+
+  for (i = 0; i < segments; i++)
+  {
+    if (datetime_read_segment(rc, i, &format, &font, &locale, &angle))
+      datetime_add_segment(datetime, format, font, locale, angle);
+  }
 }
 
 /*
@@ -566,6 +2345,27 @@ static int datetime_set_size(XfcePanelPlugin *plugin,
     gint size,
     t_datetime *datetime)
 {
+  GtkStyleContext *context;
+  GtkBorder padding, border;
+
+  /* the lines fill a row of the panel, inside the button */
+  context = gtk_widget_get_style_context(datetime->button);
+  gtk_style_context_get_padding(context, gtk_style_context_get_state(context), &padding);
+  gtk_style_context_get_border(context, gtk_style_context_get_state(context), &border);
+  datetime->row_size = size / xfce_panel_plugin_get_nrows(plugin);
+  if (datetime->vertical)
+    datetime->row_size -= padding.left + padding.right + border.left + border.right;
+  else
+    datetime->row_size -= padding.top + padding.bottom + border.top + border.bottom;
+
+  datetime_fit_fonts(datetime, FALSE);
+
+  /* the clock face is as high as a row */
+  gtk_widget_set_size_request(datetime->analog_area,
+                              datetime->row_size, datetime->row_size);
+
+  datetime_schedule_snapshot(datetime);
+
   /* return true to please the signal handler ;) */
   return TRUE;
 }
@@ -578,14 +2378,32 @@ static void datetime_read_rc_file(XfcePanelPlugin *plugin, t_datetime *dt)
   gchar *file;
   XfceRc *rc = NULL;
   t_layout layout;
+  t_calendar_view calendar_view;
+  gint timer_slack;
+  gint battery_throttle;
+  gboolean string_tables;
+  gboolean auto_fit;
   const gchar *date_font, *time_font, *date_format, *time_format;
+  const gchar *date_locale, *time_locale;
+  const gchar *zone;
 
   /* load defaults */
   layout = LAYOUT_DATE_TIME;
+  calendar_view = CALENDAR_VIEW_MONTH;
+  timer_slack = 0;
+  battery_throttle = 100;
+  string_tables = FALSE;
+  auto_fit = FALSE;
   date_font = "Bitstream Vera Sans 8";
   time_font = "Bitstream Vera Sans 8";
   date_format = "%Y-%m-%d";
   time_format = "%H:%M";
+  date_locale = "";
+  time_locale = "";
+  zone = "";
+
+  /* recompute the rest once all settings are applied */
+  datetime_apply_begin(dt);
 
   /* open file */
   if((file = xfce_panel_plugin_lookup_rc_file(plugin)) != NULL)
@@ -596,25 +2414,161 @@ static void datetime_read_rc_file(XfcePanelPlugin *plugin, t_datetime *dt)
     if(rc != NULL)
     {
       layout      = xfce_rc_read_int_entry(rc, "layout", layout);
+      timer_slack = xfce_rc_read_int_entry(rc, "timer_slack", timer_slack);
+      calendar_view = xfce_rc_read_int_entry(rc, "calendar_view", calendar_view);
+      battery_throttle = xfce_rc_read_int_entry(rc, "battery_throttle", battery_throttle);
+      string_tables = xfce_rc_read_bool_entry(rc, "string_tables", string_tables);
+      auto_fit = xfce_rc_read_bool_entry(rc, "auto_fit", auto_fit);
       date_font   = xfce_rc_read_entry(rc, "date_font", date_font);
       time_font   = xfce_rc_read_entry(rc, "time_font", time_font);
       date_format = xfce_rc_read_entry(rc, "date_format", date_format);
       time_format = xfce_rc_read_entry(rc, "time_format", time_format);
+      date_locale = xfce_rc_read_entry(rc, "date_locale", date_locale);
+      time_locale = xfce_rc_read_entry(rc, "time_locale", time_locale);
+      zone        = xfce_rc_read_entry(rc, "timezone", zone);
     }
   }
 
+  datetime_read_segments(dt, rc);
+
   date_font   = g_strdup(date_font);
   time_font   = g_strdup(time_font);
   date_format = g_strdup(date_format);
   time_format = g_strdup(time_format);
+  date_locale = g_strdup(date_locale);
+  time_locale = g_strdup(time_locale);
+  zone        = g_strdup(zone);
 
   if(rc != NULL)
     xfce_rc_close(rc);
 
-  /* set values in dt struct */
+  /* set values in dt struct; the timer and the strings follow the new ones */
+  timer_slack = MAX(timer_slack, 0);
+  battery_throttle = CLAMP(battery_throttle, 0, 100);
+  if (dt->timer_slack != timer_slack || dt->battery_throttle != battery_throttle ||
+      dt->string_tables != string_tables)
+    dt->apply_pending |= DATETIME_APPLY_INTERVAL;
+  dt->timer_slack = timer_slack;
+  dt->battery_throttle = battery_throttle;
+  if (dt->string_tables && !string_tables)
+  {
+    datetime_reset_table(&dt->date_text);
+    datetime_reset_table(&dt->time_text);
+  }
+  dt->string_tables = string_tables;
+  if (dt->auto_fit != auto_fit)
+  {
+    /* restyle the labels with fitted or fixed fonts */
+    dt->auto_fit = auto_fit;
+    dt->apply_pending |= DATETIME_APPLY_DATE_FONT | DATETIME_APPLY_TIME_FONT;
+  }
+  if (calendar_view < CALENDAR_VIEW_COUNT)
+    dt->calendar_view = calendar_view;
   datetime_apply_layout(dt, layout);
   datetime_apply_font(dt, date_font, time_font);
   datetime_apply_format(dt, date_format, time_format);
+  datetime_apply_locale(dt, date_locale, time_locale);
+  datetime_apply_timezone(dt, zone);
+  datetime_apply_end(dt);
+
+  g_free((gchar *) date_font);
+  g_free((gchar *) time_font);
+  g_free((gchar *) date_format);
+  g_free((gchar *) time_format);
+  g_free((gchar *) date_locale);
+  g_free((gchar *) time_locale);
+  g_free((gchar *) zone);
+}
+
+/*
+ * Checksum of the contents of the rc file, or NULL if it cannot be read
+ */
+static gchar * datetime_rc_file_checksum(XfcePanelPlugin *plugin)
+{
+  gchar *path;
+  gchar *contents = NULL;
+  gsize length;
+  gchar *checksum = NULL;
+
+  path = xfce_panel_plugin_save_location(plugin, FALSE);
+  if (path != NULL && g_file_get_contents(path, &contents, &length, NULL))
+    checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA1,
+                                           (const guchar *) contents, length);
+  g_free(contents);
+  g_free(path);
+
+  return checksum;
+}
+
+/*
+ * Apply the settings of an rc file changed by someone else.
+ * Only what differs from the current settings is applied again, e.g. a new
+ * format neither restyles nor reorders the labels. The file as the plugin
+ * wrote it is not read again.
+ */
+static gboolean datetime_reload_rc_file(t_datetime *datetime)
+{
+  gchar *checksum = datetime_rc_file_checksum(datetime->plugin);
+  gboolean own = checksum != NULL && g_strcmp0(checksum, datetime->rc_written) == 0;
+
+  g_free(checksum);
+  if (own)
+    return G_SOURCE_CONTINUE;
+
+  DBG("reloading the rc file");
+
+  datetime_read_rc_file(datetime->plugin, datetime);
+  datetime_dialog_refresh(datetime);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/*
+ * Editors and configuration management write a file in several steps,
+ * so it is read once it was left alone for a moment.
+ */
+static void datetime_rc_file_changed(GFileMonitor *monitor,
+    GFile *file,
+    GFile *other_file,
+    GFileMonitorEvent event_type,
+    t_datetime *datetime)
+{
+  switch (event_type)
+  {
+    case G_FILE_MONITOR_EVENT_CHANGED:
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+    case G_FILE_MONITOR_EVENT_RENAMED:
+      g_source_set_ready_time(datetime->reload_source,
+          g_get_monotonic_time() + DATETIME_RELOAD_DELAY * 1000);
+      break;
+    default:
+      break;
+  }
+}
+
+/*
+ * Watch the rc file the plugin saves to, which need not exist yet
+ */
+static void datetime_watch_rc_file(t_datetime *datetime)
+{
+  gchar *path;
+  GFile *file;
+
+  path = xfce_panel_plugin_save_location(datetime->plugin, FALSE);
+  if (path == NULL)
+    return;
+
+  file = g_file_new_for_path(path);
+  datetime->rc_monitor = g_file_monitor_file(file, G_FILE_MONITOR_WATCH_MOVES,
+                                             NULL, NULL);
+  if (datetime->rc_monitor != NULL)
+    g_signal_connect(datetime->rc_monitor, "changed",
+        G_CALLBACK(datetime_rc_file_changed), datetime);
+  g_object_unref(file);
+  g_free(path);
 }
 
 /*
@@ -624,6 +2578,9 @@ void datetime_write_rc_file(XfcePanelPlugin *plugin, t_datetime *dt)
 {
   char *file;
   XfceRc *rc;
+  t_segment *segment;
+  gchar key[32];
+  guint i;
 
   if(!(file = xfce_panel_plugin_save_location(plugin, TRUE)))
     return;
@@ -634,12 +2591,44 @@ void datetime_write_rc_file(XfcePanelPlugin *plugin, t_datetime *dt)
   if(rc != NULL)
   {
     xfce_rc_write_int_entry(rc, "layout", dt->layout);
+    xfce_rc_write_int_entry(rc, "timer_slack", dt->timer_slack);
+    xfce_rc_write_int_entry(rc, "calendar_view", dt->calendar_view);
+    xfce_rc_write_int_entry(rc, "battery_throttle", dt->battery_throttle);
+    xfce_rc_write_bool_entry(rc, "string_tables", dt->string_tables);
+    xfce_rc_write_bool_entry(rc, "auto_fit", dt->auto_fit);
     xfce_rc_write_entry(rc, "date_font", dt->date_font);
     xfce_rc_write_entry(rc, "time_font", dt->time_font);
     xfce_rc_write_entry(rc, "date_format", dt->date_format);
     xfce_rc_write_entry(rc, "time_format", dt->time_format);
+    xfce_rc_write_entry(rc, "date_locale", dt->date_locale);
+    xfce_rc_write_entry(rc, "time_locale", dt->time_locale);
+    xfce_rc_write_entry(rc, "timezone", dt->timezone);
+
+    xfce_rc_write_int_entry(rc, "segments", dt->segments->len);
+    for (i = 0; i < dt->segments->len; i++)
+    {
+      segment = g_ptr_array_index(dt->segments, i);
+      g_snprintf(key, sizeof(key), "segment%u_format", i);
+      xfce_rc_write_entry(rc, key, segment->format);
+      g_snprintf(key, sizeof(key), "segment%u_font", i);
+      if (segment->font != NULL)
+        xfce_rc_write_entry(rc, key, segment->font);
+      else
+        xfce_rc_delete_entry(rc, key, FALSE);
+      g_snprintf(key, sizeof(key), "segment%u_locale", i);
+      if (segment->locale != NULL)
+        xfce_rc_write_entry(rc, key, segment->locale);
+      else
+        xfce_rc_delete_entry(rc, key, FALSE);
+      g_snprintf(key, sizeof(key), "segment%u_angle", i);
+      xfce_rc_write_int_entry(rc, key, segment->angle);
+    }
 
     xfce_rc_close(rc);
+
+    /* the monitor reports this write, too */
+    g_free(dt->rc_written);
+    dt->rc_written = datetime_rc_file_checksum(plugin);
   }
 
 }
@@ -651,6 +2640,9 @@ static void datetime_set_mode(XfcePanelPlugin *plugin, XfcePanelPluginMode mode,
 {
   GtkOrientation orientation = (mode == XFCE_PANEL_PLUGIN_MODE_VERTICAL) ?
     GTK_ORIENTATION_VERTICAL : GTK_ORIENTATION_HORIZONTAL;
+  t_segment *segment;
+  guint i;
+
   if (orientation == GTK_ORIENTATION_VERTICAL)
   {
     gtk_orientable_set_orientation(GTK_ORIENTABLE(datetime->box), GTK_ORIENTATION_HORIZONTAL);
@@ -667,6 +2659,19 @@ static void datetime_set_mode(XfcePanelPlugin *plugin, XfcePanelPluginMode mode,
     gtk_box_reorder_child(GTK_BOX(datetime->box), datetime->date_label, 0);
     gtk_box_reorder_child(GTK_BOX(datetime->box), datetime->time_label, 1);
   }
+
+  datetime->vertical = (orientation == GTK_ORIENTATION_VERTICAL);
+  for (i = 0; i < datetime->segments->len; i++)
+  {
+    segment = g_ptr_array_index(datetime->segments, i);
+    gtk_label_set_angle(GTK_LABEL(segment->label),
+                        datetime_segment_angle(datetime, segment));
+  }
+
+  /* the row size takes the padding across the panel, so fit again */
+  datetime->fit_row_size = 0;
+  datetime_set_size(plugin, xfce_panel_plugin_get_size(plugin), datetime);
+  datetime_update_rotated(datetime);
 }
 
 /*
@@ -699,9 +2704,38 @@ static void datetime_create_widget(t_datetime * datetime)
   gtk_box_pack_start(GTK_BOX(datetime->box),
       datetime->date_label, TRUE, FALSE, 0);
 
+  /* area drawing both lines from cached glyphs on vertical panels */
+  datetime->rotated_area = gtk_drawing_area_new();
+  datetime->rotated_date = datetime_rotated_line_new();
+  datetime->rotated_time = datetime_rotated_line_new();
+  gtk_widget_set_no_show_all(datetime->rotated_area, TRUE);
+  gtk_box_pack_start(GTK_BOX(datetime->box),
+      datetime->rotated_area, TRUE, FALSE, 0);
+  g_signal_connect(datetime->rotated_area, "draw",
+      G_CALLBACK(datetime_rotated_draw), datetime);
+  g_signal_connect_swapped(datetime->rotated_area, "style-updated",
+      G_CALLBACK(datetime_rotated_style_updated), datetime);
+  g_signal_connect_swapped(datetime->rotated_area, "notify::scale-factor",
+      G_CALLBACK(datetime_rotated_style_updated), datetime);
+
+  /* clock face drawn over a cached dial */
+  datetime->analog_area = gtk_drawing_area_new();
+  datetime->analog = datetime_analog_face_new();
+  gtk_widget_set_no_show_all(datetime->analog_area, TRUE);
+  gtk_box_pack_start(GTK_BOX(datetime->box),
+      datetime->analog_area, TRUE, FALSE, 0);
+  g_signal_connect(datetime->analog_area, "draw",
+      G_CALLBACK(datetime_analog_draw), datetime);
+  g_signal_connect_swapped(datetime->analog_area, "style-updated",
+      G_CALLBACK(datetime_analog_style_updated), datetime);
+
   /* connect widget signals to functions */
   g_signal_connect(datetime->button, "button-press-event",
       G_CALLBACK(datetime_clicked), datetime);
+  g_signal_connect(datetime->button, "enter-notify-event",
+      G_CALLBACK(datetime_crossing), datetime);
+  g_signal_connect(datetime->button, "leave-notify-event",
+      G_CALLBACK(datetime_crossing), datetime);
 
   /* set orientation according to the panel orientation */
   datetime_set_mode(datetime->plugin, orientation, datetime);
@@ -710,7 +2744,7 @@ static void datetime_create_widget(t_datetime * datetime)
 /*
  * create datetime plugin
  */
-static t_datetime * datetime_new(XfcePanelPlugin *plugin)
+t_datetime * datetime_new(XfcePanelPlugin *plugin)
 {
   t_datetime * datetime;
 
@@ -722,14 +2756,44 @@ static t_datetime * datetime_new(XfcePanelPlugin *plugin)
   /* store plugin reference */
   datetime->plugin = plugin;
 
+  /* timers for the updates and for preparing their strings */
+  datetime->update_source = datetime_timer_new(G_PRIORITY_DEFAULT,
+      (GSourceFunc) datetime_update, datetime);
+  datetime->worker = datetime_worker_new((GSourceFunc) datetime_worker_render,
+      datetime, (GDestroyNotify) datetime_render_frame_release);
+
+  /* lines after the date and time, added by the settings */
+  datetime->segments = g_ptr_array_new_with_free_func(
+      (GDestroyNotify) datetime_segment_free);
+
   /* call widget-create function */
   datetime_create_widget(datetime);
 
-  /* load settings (default values if non-av) */
+  datetime->latency = datetime_latency_new();
+
+  /* watch the battery to throttle updates */
+  datetime->power = datetime_power_monitor_new(
+      (t_power_changed_func) datetime_refresh_interval, datetime);
+
+  /* load settings (default values if non-av), which lays out
+   * and sets the date and time labels for the first time */
+  datetime->apply_pending = DATETIME_APPLY_LAYOUT | DATETIME_APPLY_FORMAT;
   datetime_read_rc_file(plugin, datetime);
 
-  /* set date and time labels */
-  datetime_update(datetime);
+  /* with the fonts and the row size of the last run, if they still apply */
+  datetime_restore_snapshot(datetime);
+  datetime->snapshot_source = datetime_timer_new(G_PRIORITY_LOW,
+      (GSourceFunc) datetime_save_snapshot, datetime);
+
+  /* fonts are resolved again when the installed ones change */
+  datetime->fonts_handler_id = g_signal_connect_swapped(gtk_settings_get_default(),
+      "notify::gtk-fontconfig-timestamp",
+      G_CALLBACK(datetime_fonts_changed), datetime);
+
+  /* and follow changes others make to them */
+  datetime->reload_source = datetime_timer_new(G_PRIORITY_DEFAULT_IDLE,
+      (GSourceFunc) datetime_reload_rc_file, datetime);
+  datetime_watch_rc_file(datetime);
 
   return datetime;
 }
@@ -737,22 +2801,78 @@ static t_datetime * datetime_new(XfcePanelPlugin *plugin)
 /*
  * frees the datetime struct
  */
-static void datetime_free(XfcePanelPlugin *plugin, t_datetime *datetime)
+void datetime_free(XfcePanelPlugin *plugin, t_datetime *datetime)
 {
+  guint i;
+
   /* stop timeouts */
-  if (datetime->timeout_id != 0)
-    g_source_remove(datetime->timeout_id);
   if (datetime->tooltip_timeout_id != 0)
     g_source_remove(datetime->tooltip_timeout_id);
+  g_source_destroy(datetime->update_source);
+  g_source_unref(datetime->update_source);
+  g_source_destroy(datetime->reload_source);
+  g_source_unref(datetime->reload_source);
+  g_source_destroy(datetime->snapshot_source);
+  g_source_unref(datetime->snapshot_source);
+  if (datetime->fonts_handler_id != 0)
+    g_signal_handler_disconnect(gtk_settings_get_default(),
+                                datetime->fonts_handler_id);
+  if (datetime->rc_monitor != NULL)
+  {
+    g_file_monitor_cancel(datetime->rc_monitor);
+    g_object_unref(datetime->rc_monitor);
+  }
+  datetime_discard_prerender(datetime);
+  datetime_worker_free(datetime->worker);
+  datetime->worker = NULL;
+  if (datetime->render_job != NULL)
+    datetime_render_job_unref(datetime->render_job);
+  datetime_power_monitor_free(datetime->power);
+  datetime_latency_free(datetime->latency);
 
   /* destroy widget */
+  if (datetime->dialog != NULL)
+    gtk_widget_destroy(datetime->dialog);
+  if (datetime->zone_cancellable != NULL)
+  {
+    g_cancellable_cancel(datetime->zone_cancellable);
+    g_object_unref(datetime->zone_cancellable);
+  }
+  if (datetime->zone_search != NULL)
+    datetime_zone_search_free(datetime->zone_search);
   gtk_widget_destroy(datetime->button);
+  datetime_rotated_line_free(datetime->rotated_date);
+  datetime_rotated_line_free(datetime->rotated_time);
+  datetime_analog_face_free(datetime->analog);
+  g_ptr_array_free(datetime->segments, TRUE);
+  for (i = 0; i < DATETIME_CALENDAR_MONTHS; i++)
+    if (datetime->cal_pool[i] != NULL)
+      g_object_unref(datetime->cal_pool[i]);
+  if (datetime->cal_marks != NULL)
+    g_hash_table_destroy(datetime->cal_marks);
 
   /* cleanup */
+  datetime_markup_free(datetime->date_text.markup);
+  datetime_markup_free(datetime->time_text.markup);
+  datetime_format_free(datetime->date_text.compiled);
+  datetime_format_free(datetime->time_text.compiled);
+  datetime_string_table_free(datetime->date_text.table);
+  datetime_string_table_free(datetime->time_text.table);
   g_free(datetime->date_font);
   g_free(datetime->time_font);
+  g_free(datetime->date_fit_font);
+  g_free(datetime->time_fit_font);
+  g_free(datetime->date_match);
+  g_free(datetime->time_match);
+  datetime_snapshot_free(datetime->snapshot);
   g_free(datetime->date_format);
   g_free(datetime->time_format);
+  g_free(datetime->date_locale);
+  g_free(datetime->time_locale);
+  g_free(datetime->timezone);
+  g_free(datetime->rc_written);
+  if (datetime->tz != NULL)
+    g_time_zone_unref(datetime->tz);
 
   g_slice_free(t_datetime, datetime);
 }
@@ -762,6 +2882,8 @@ static void datetime_free(XfcePanelPlugin *plugin, t_datetime *datetime)
  */
 static void datetime_construct(XfcePanelPlugin *plugin)
 {
+  gint64 start_time = g_get_monotonic_time();
+
   /* create datetime plugin */
   t_datetime * datetime = datetime_new(plugin);
 
@@ -780,6 +2902,8 @@ static void datetime_construct(XfcePanelPlugin *plugin)
       G_CALLBACK(datetime_properties_dialog), datetime);
   g_signal_connect(plugin, "mode-changed", G_CALLBACK(datetime_set_mode), datetime);
   xfce_panel_plugin_menu_show_configure(plugin);
+
+  datetime_report_timing("construct", start_time);
 }
 
 
@@ -22,6 +22,33 @@
 #ifndef DATETIME_H
 #define DATETIME_H
 
+#include <time.h>
+#include <libxfce4panel/libxfce4panel.h>
+
+#include "datetime-rotated.h"
+#include "datetime-analog.h"
+#include "datetime-power.h"
+#include "datetime-latency.h"
+#include "datetime-locale.h"
+#include "datetime-markup.h"
+#include "datetime-table.h"
+#include "datetime-format.h"
+#include "datetime-worker.h"
+#include "datetime-job.h"
+#include "datetime-zones.h"
+#include "datetime-snapshot.h"
+
+#define DATETIME_MAX_STRLEN 256
+
+/* room for a DATETIME_MAX_STRLEN strftime() result converted to UTF-8 */
+#define DATETIME_TEXT_SIZE (DATETIME_MAX_STRLEN * 3)
+
+/* most months a calendar view shows at once */
+#define DATETIME_CALENDAR_MONTHS 12
+
+/* number of recent timer dispatch latencies the wake lead is learned from */
+#define DATETIME_DISPATCH_WINDOW 64
+
 /* enums */
 enum {
   DATE = 0,
@@ -35,28 +62,123 @@ typedef enum
   LAYOUT_TIME_DATE,
   LAYOUT_DATE,
   LAYOUT_TIME,
+  LAYOUT_ANALOG,
   LAYOUT_COUNT
 } t_layout;
 
+typedef enum
+{
+  CALENDAR_VIEW_MONTH = 0,
+  CALENDAR_VIEW_THREE_MONTHS,
+  CALENDAR_VIEW_YEAR,
+  CALENDAR_VIEW_COUNT
+} t_calendar_view;
+
+/* strings of one label, rendered only when their fields change */
+typedef struct {
+  gchar text[2][DATETIME_TEXT_SIZE];  /* shown and next strings */
+  gint64 period[2];       /* period of the granularity each string is for */
+  guint granularity;      /* seconds between changes of the string */
+  t_datetime_markup *markup;  /* attributes of a format with markup, or NULL */
+  t_datetime_format *compiled;  /* the format without markup, compiled */
+  t_datetime_locale *locale;  /* locale of the label, or NULL for the process one */
+  t_string_table *table;      /* every string of a day or year, or NULL */
+  gboolean no_table;          /* the format shows both the date and the time */
+} t_datetime_text;
+
+/* an additional line of the layout, configured in the rc file */
+typedef struct {
+  GtkWidget *label;
+  gchar *format;
+  gchar *font;
+  gchar *locale;
+  gint angle;
+  t_datetime_text text;
+  t_rotated_line *rotated;    /* the text on vertical panels */
+  gchar *fit_font;            /* font fitted to the panel, or NULL */
+} t_segment;
+
 typedef struct {
   XfcePanelPlugin * plugin;
   GtkWidget *button;
   GtkWidget *box;
   GtkWidget *date_label;
   GtkWidget *time_label;
+  GtkWidget *rotated_area;
+  t_rotated_line *rotated_date;
+  t_rotated_line *rotated_time;
+  GtkWidget *analog_area;
+  t_analog_face *analog;
+  gboolean vertical;
+  gboolean rotated;       /* vertical text is drawn from cached glyphs */
   guint update_interval;  /* time between updates in milliseconds */
-  guint timeout_id;
+  GSource *update_source;
+  gboolean coalesce;      /* whether the update timer may be coalesced */
+  gint64 wake_time;       /* intended time of the next update in milliseconds */
+  guint wake_lateness;    /* lateness of the last update in milliseconds */
+  guint wake_lateness_max;
+  guint wake_overshoots;  /* consecutive coalesced updates later than the slack */
+  gint64 update_ready;    /* monotonic time the update timer is armed for, or 0 */
+  gint dispatch_latency[DATETIME_DISPATCH_WINDOW];  /* in microseconds */
+  guint dispatch_count;
+  guint wake_lead;        /* microseconds the timer is armed before the boundary */
+  t_latency *latency;     /* lateness of updates on screen */
+  gint64 update_due;      /* monotonic time the next update is due, or 0 */
+  t_render_worker *worker;  /* prepares the strings off the main loop */
+  t_render_job *render_job;  /* what the worker renders, or NULL */
+  gpointer render_request;  /* frame handed to the worker, atomic */
+  time_t render_stamp;    /* time the worker is asked to render for, or 0 */
+  guint render_generation;  /* counts the jobs built */
+  GTimeZone *tz;          /* zone the time is shown in, or NULL for the local one */
+  t_power_monitor *power;
+  gboolean throttled;     /* seconds are not shown to save power */
+  gboolean hovered;
+  time_t next_stamp;      /* time the prepared strings were rendered for */
+  glong next_gmtoff;      /* UTC offset the prepared strings were rendered with */
+  t_datetime_text date_text;
+  t_datetime_text time_text;
+  guint text_next;        /* index of the buffers for the next update */
   guint tooltip_timeout_id;
   gulong tooltip_handler_id;
+  guint apply_depth;      /* nesting of datetime_apply_begin() */
+  guint apply_pending;    /* changes not committed yet */
+  GFileMonitor *rc_monitor;
+  GSource *reload_source; /* reads the rc file after it was changed */
+  gchar *rc_written;      /* checksum of the rc file the plugin wrote, or NULL */
+  t_render_snapshot *snapshot;  /* the saved layout, or NULL */
+  GSource *snapshot_source;     /* saves the layout after it settled */
 
   /* settings */
   gchar *date_font;
   gchar *time_font;
   gchar *date_format;
   gchar *time_format;
+  gchar *date_locale;     /* empty for the process locale */
+  gchar *time_locale;
+  gchar *timezone;        /* empty for the local time */
   t_layout layout;
+  GPtrArray *segments;    /* t_segment shown after the date and time */
+  guint timer_slack;      /* acceptable lateness of minute updates in milliseconds */
+  t_calendar_view calendar_view;
+  guint battery_throttle; /* battery charge in percent below which seconds are throttled */
+  gboolean string_tables; /* look up strings in tables built when applying */
+  gboolean auto_fit;      /* grow or shrink the fonts with the panel */
+  gchar *date_fit_font;   /* fonts fitted to the panel, or NULL */
+  gchar *time_fit_font;
+  gchar *date_match;      /* installed fonts the fonts resolved to */
+  gchar *time_match;
+  gulong fonts_handler_id;  /* follows fontconfig changes */
+  gint fit_row_size;      /* row size the fonts were fitted to, or 0 */
+  gint row_size;          /* pixels available for the lines */
 
-  /* option widgets */
+  /* option widgets, kept while the plugin lives */
+  GtkWidget *dialog;
+  GtkWidget *layout_combobox;
+  GtkWidget *calendar_combobox;
+  GtkWidget *timezone_entry;
+  GtkListStore *zone_store;     /* completions of the time zone entry */
+  t_zone_search *zone_search;   /* NULL until the zone index is loaded */
+  GCancellable *zone_cancellable;
   GtkWidget *date_frame;
   GtkWidget *date_tooltip_label;
   GtkWidget *date_font_hbox;
@@ -72,15 +194,36 @@ typedef struct {
 
   /* popup calendar */
   GtkWidget *cal;
+  GtkWidget *cal_pool[DATETIME_CALENDAR_MONTHS];  /* GtkCalendar widgets recycled
+                                                   between months, built when
+                                                   their place is first shown */
+  GtkWidget *cal_slots[DATETIME_CALENDAR_MONTHS]; /* places of the calendars in
+                                                   the popup grid, or NULL */
+  GtkAdjustment *cal_adjustment;                  /* scrolls the popup grid */
+  guint cal_visible_id;                           /* attaches the calendars in view */
+  GHashTable *cal_marks;  /* month -> bitmask of marked days */
+  gint cal_today;         /* day the marks were computed on */
+  gint cal_first_month;   /* first visible month, counted from year 0 */
 } t_datetime;
 
+t_datetime *
+datetime_new(XfcePanelPlugin *plugin);
+
+void
+datetime_free(XfcePanelPlugin *plugin,
+    t_datetime *datetime);
+
 gboolean
 datetime_update(t_datetime *datetime);
 
-gchar *
-datetime_do_utf8strftime(
-    const char *format,
-    const struct tm *tm);
+void
+datetime_report_timing(const gchar *phase, gint64 start_time);
+
+void
+datetime_apply_begin(t_datetime *datetime);
+
+void
+datetime_apply_end(t_datetime *datetime);
 
 void
 datetime_apply_font(t_datetime *datetime,
@@ -92,6 +235,15 @@ datetime_apply_format(t_datetime *datetime,
     const gchar *date_format,
     const gchar *time_format);
 
+void
+datetime_apply_locale(t_datetime *datetime,
+    const gchar *date_locale,
+    const gchar *time_locale);
+
+void
+datetime_apply_timezone(t_datetime *datetime,
+    const gchar *zone);
+
 void
 datetime_apply_layout(t_datetime *datetime,
     t_layout layout);
@@ -0,0 +1,99 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+/*
+ * How many timestamps a second the compiled formats render, compared to
+ * breaking every one down with localtime_r() and rendering it with
+ * strftime(). Consecutive seconds are rendered, as the clock and the
+ * string tables do. Run with "make benchmark".
+ */
+
+/* local includes */
+#include <time.h>
+#include <glib.h>
+
+#include "panel-plugin/datetime-locale.h"
+#include "panel-plugin/datetime-format.h"
+
+#define BENCH_FORMAT "%Y-%m-%d %H:%M:%S"
+
+/* timestamps rendered per call, and the number of calls */
+#define BENCH_BATCH 4096
+#define BENCH_ROUNDS 1000
+
+/* room for a string of the format */
+#define BENCH_STRIDE 32
+
+static void bench_report(const gchar *name, gint64 elapsed, gchar *sample)
+{
+  gdouble rate = (gdouble) BENCH_BATCH * BENCH_ROUNDS * G_USEC_PER_SEC / MAX(elapsed, 1);
+
+  g_print("%-12s %8.2f M timestamps/s  (%s)\n", name, rate / 1e6, sample);
+}
+
+int main(int argc, char **argv)
+{
+  t_datetime_format *format;
+  GTimeZone *tz;
+  gint64 *stamps;
+  gchar *out;
+  gint64 start;
+  gint64 stamp = 1700000000;
+  struct tm tm;
+  time_t t;
+  guint round, i;
+
+  format = datetime_format_new(BENCH_FORMAT);
+  tz = g_time_zone_new_local();
+  stamps = g_new(gint64, BENCH_BATCH);
+  out = g_malloc(BENCH_BATCH * BENCH_STRIDE);
+
+  start = g_get_monotonic_time();
+  for (round = 0; round < BENCH_ROUNDS; round++)
+  {
+    for (i = 0; i < BENCH_BATCH; i++)
+      stamps[i] = stamp++;
+    datetime_format_render_stamps(format, NULL, tz, stamps, BENCH_BATCH,
+                                  out, BENCH_STRIDE);
+  }
+  bench_report("compiled", g_get_monotonic_time() - start, out);
+
+  stamp = 1700000000;
+  start = g_get_monotonic_time();
+  for (round = 0; round < BENCH_ROUNDS; round++)
+  {
+    for (i = 0; i < BENCH_BATCH; i++)
+    {
+      t = stamp++;
+      localtime_r(&t, &tm);
+      strftime(out + i * BENCH_STRIDE, BENCH_STRIDE, BENCH_FORMAT, &tm);
+    }
+  }
+  bench_report("strftime", g_get_monotonic_time() - start, out);
+
+  g_free(out);
+  g_free(stamps);
+  g_time_zone_unref(tz);
+  datetime_format_free(format);
+
+  return 0;
+}
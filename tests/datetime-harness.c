@@ -0,0 +1,310 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/*
+ * A mock panel which loads the plugin module into a window, drives it through
+ * the signals of a real panel and reports how long every step took, e.g.
+ *
+ *   xvfb-run -a ./datetime-harness ../panel-plugin/.libs/libdatetime.so
+ */
+
+/* local includes */
+#include <string.h>
+#include <stdio.h>
+#include <sys/resource.h>
+
+/* xfce includes */
+#include <gmodule.h>
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4panel/libxfce4panel.h>
+
+/* the settings the plugin is started with: seconds, so that it ticks */
+#define HARNESS_RC \
+  "layout=0\n" \
+  "date_format=%Y-%m-%d\n" \
+  "time_format=%H:%M:%S\n" \
+  "calendar_view=2\n"
+
+typedef XfcePanelPlugin * (*t_construct_func)(const gchar *name,
+                                              gint unique_id,
+                                              const gchar *display_name,
+                                              const gchar *comment,
+                                              gchar **arguments,
+                                              GdkScreen *screen);
+
+static gint harness_ticks = 10;
+static gint harness_size = 32;
+
+static GOptionEntry harness_options[] = {
+  { "ticks", 't', 0, G_OPTION_ARG_INT, &harness_ticks,
+    "Seconds the tick cost is measured for", "N" },
+  { "size", 's', 0, G_OPTION_ARG_INT, &harness_size,
+    "Size of the mock panel in pixels", "PIXELS" },
+  { NULL }
+};
+
+/* resident set size in kB */
+static glong harness_rss(void)
+{
+  gchar *contents = NULL;
+  gchar *line;
+  glong rss = -1;
+
+  if (g_file_get_contents("/proc/self/status", &contents, NULL, NULL))
+  {
+    line = strstr(contents, "VmRSS:");
+    if (line != NULL)
+      sscanf(line, "VmRSS: %ld", &rss);
+    g_free(contents);
+  }
+
+  return rss;
+}
+
+/* user and system time of the process in microseconds */
+static gint64 harness_cpu_time(void)
+{
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+
+  return (gint64) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC +
+         usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void harness_report(const gchar *phase, gint64 start_time)
+{
+  g_print("%-16s %8.2f ms   rss %6ld kB\n", phase,
+          (g_get_monotonic_time() - start_time) / 1000.0, harness_rss());
+}
+
+/* run the main loop until everything queued, e.g. drawing, is done */
+static void harness_flush(void)
+{
+  while (gtk_events_pending())
+    gtk_main_iteration_do(FALSE);
+}
+
+static gboolean harness_quit(GMainLoop *loop)
+{
+  g_main_loop_quit(loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* let the plugin run for some seconds */
+static void harness_run(guint seconds)
+{
+  GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+
+  g_timeout_add_seconds(seconds, (GSourceFunc) harness_quit, loop);
+  g_main_loop_run(loop);
+  g_main_loop_unref(loop);
+}
+
+/* a visible toplevel other than the panel, e.g. the popup or the dialog */
+static GtkWidget * harness_find_window(GtkWidget *panel, GType type)
+{
+  GList *toplevels = gtk_window_list_toplevels();
+  GList *li;
+  GtkWidget *found = NULL;
+
+  for (li = toplevels; li != NULL && found == NULL; li = li->next)
+    if (li->data != panel && gtk_widget_get_mapped(li->data) &&
+        G_TYPE_CHECK_INSTANCE_TYPE(li->data, type))
+      found = li->data;
+  g_list_free(toplevels);
+
+  return found;
+}
+
+/* press and release the first button over the plugin */
+static void harness_click(GtkWidget *widget)
+{
+  GdkEvent *event;
+  GdkEventType types[2] = { GDK_BUTTON_PRESS, GDK_BUTTON_RELEASE };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(types); i++)
+  {
+    event = gdk_event_new(types[i]);
+    event->button.window = g_object_ref(gtk_widget_get_window(widget));
+    event->button.button = 1;
+    event->button.time = GDK_CURRENT_TIME;
+    event->button.x = 1;
+    event->button.y = 1;
+    gdk_event_set_device(event, gdk_seat_get_pointer(
+        gdk_display_get_default_seat(gtk_widget_get_display(widget))));
+    gtk_main_do_event(event);
+    gdk_event_free(event);
+  }
+}
+
+/* the plugin reads its settings from a scratch configuration directory */
+static gchar * harness_prepare_config(void)
+{
+  gchar *dir = g_dir_make_tmp("datetime-harness-XXXXXX", NULL);
+  gchar *config_dir, *panel_dir, *rc, *cache_dir;
+
+  g_assert(dir != NULL);
+
+  config_dir = g_build_filename(dir, "config", NULL);
+  panel_dir = g_build_filename(config_dir, "xfce4", "panel", NULL);
+  g_mkdir_with_parents(panel_dir, 0700);
+  rc = g_build_filename(panel_dir, "datetime-1.rc", NULL);
+  g_file_set_contents(rc, HARNESS_RC, -1, NULL);
+
+  cache_dir = g_build_filename(dir, "cache", NULL);
+  g_setenv("XDG_CONFIG_HOME", config_dir, TRUE);
+  g_setenv("XDG_CACHE_HOME", cache_dir, TRUE);
+
+  g_free(cache_dir);
+  g_free(rc);
+  g_free(panel_dir);
+  g_free(config_dir);
+
+  return dir;
+}
+
+int main(int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  GModule *module;
+  t_construct_func construct;
+  XfcePanelPlugin *plugin;
+  GtkWidget *panel;
+  GtkWidget *button;
+  GtkWidget *popup;
+  GtkWidget *dialog;
+  gchar *dir;
+  gint64 start_time, cpu_time;
+  gboolean ret;
+  gint sizes[3];
+  guint i;
+
+  context = g_option_context_new("MODULE - run the plugin in a mock panel");
+  g_option_context_add_main_entries(context, harness_options, NULL);
+  g_option_context_add_group(context, gtk_get_option_group(TRUE));
+  if (!g_option_context_parse(context, &argc, &argv, &error) || argc != 2)
+  {
+    g_printerr("%s\n", error != NULL ? error->message : "No plugin module given");
+    return 2;
+  }
+  g_option_context_free(context);
+
+  dir = harness_prepare_config();
+
+  module = g_module_open(argv[1], G_MODULE_BIND_LOCAL);
+  if (module == NULL ||
+      !g_module_symbol(module, "xfce_panel_module_construct", (gpointer *) &construct))
+  {
+    g_printerr("Cannot load %s: %s\n", argv[1], g_module_error());
+    return 2;
+  }
+  g_print("%-16s %8s      %s\n", "step", "time", "after the step");
+  g_print("%-16s %8s   rss %6ld kB\n", "start", "", harness_rss());
+
+  /* the plugin is constructed once its widget is realized in the panel */
+  start_time = g_get_monotonic_time();
+  plugin = construct("datetime", 1, "DateTime", "Date and time", NULL,
+                     gdk_screen_get_default());
+  panel = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+  gtk_container_add(GTK_CONTAINER(panel), GTK_WIDGET(plugin));
+  gtk_widget_show_all(panel);
+  harness_flush();
+  harness_report("construct", start_time);
+
+  /* the size and the mode as a panel sets them */
+  sizes[0] = harness_size;
+  sizes[1] = harness_size * 2;
+  sizes[2] = harness_size;
+  for (i = 0; i < G_N_ELEMENTS(sizes); i++)
+  {
+    start_time = g_get_monotonic_time();
+    g_signal_emit_by_name(plugin, "size-changed", sizes[i], &ret);
+    harness_flush();
+    harness_report("size-changed", start_time);
+  }
+
+  start_time = g_get_monotonic_time();
+  g_signal_emit_by_name(plugin, "mode-changed", XFCE_PANEL_PLUGIN_MODE_VERTICAL);
+  harness_flush();
+  harness_report("mode vertical", start_time);
+
+  start_time = g_get_monotonic_time();
+  g_signal_emit_by_name(plugin, "mode-changed", XFCE_PANEL_PLUGIN_MODE_HORIZONTAL);
+  harness_flush();
+  harness_report("mode horizontal", start_time);
+
+  /* the CPU time of the seconds ticks, including drawing them */
+  cpu_time = harness_cpu_time();
+  start_time = g_get_monotonic_time();
+  harness_run(harness_ticks);
+  g_print("%-16s %8.2f ms   rss %6ld kB   (cpu per tick, %d ticks)\n", "tick",
+          (harness_cpu_time() - cpu_time) / 1000.0 / harness_ticks,
+          harness_rss(), harness_ticks);
+
+  /* open the popup with a click, and close it with another */
+  button = gtk_bin_get_child(GTK_BIN(plugin));
+  start_time = g_get_monotonic_time();
+  harness_click(button);
+  harness_flush();
+  popup = harness_find_window(panel, GTK_TYPE_WINDOW);
+  harness_report(popup != NULL ? "popup" : "popup (missing)", start_time);
+
+  start_time = g_get_monotonic_time();
+  harness_click(button);
+  harness_flush();
+  harness_report("popup close", start_time);
+
+  /* the properties dialog, the first time and when it is kept */
+  for (i = 0; i < 2; i++)
+  {
+    start_time = g_get_monotonic_time();
+    g_signal_emit_by_name(plugin, "configure-plugin");
+    harness_flush();
+    dialog = harness_find_window(panel, GTK_TYPE_DIALOG);
+    harness_report(dialog == NULL ? "dialog (missing)" :
+                   i == 0 ? "dialog" : "dialog again", start_time);
+    if (dialog != NULL)
+    {
+      gtk_dialog_response(GTK_DIALOG(dialog), GTK_RESPONSE_CLOSE);
+      harness_flush();
+    }
+  }
+
+  start_time = g_get_monotonic_time();
+  g_signal_emit_by_name(plugin, "save");
+  harness_flush();
+  harness_report("save", start_time);
+
+  start_time = g_get_monotonic_time();
+  g_signal_emit_by_name(plugin, "free-data");
+  gtk_widget_destroy(panel);
+  harness_flush();
+  harness_report("free", start_time);
+
+  g_print("scratch directory: %s\n", dir);
+  g_free(dir);
+
+  return 0;
+}
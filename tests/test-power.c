@@ -0,0 +1,213 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+/*
+ * The power monitor reading a fake power_supply tree in a temporary
+ * directory, and the battery charge below which updates are throttled.
+ */
+
+/* local includes */
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "panel-plugin/datetime-power.h"
+
+typedef struct {
+  gchar *dir;
+  t_power_monitor *monitor;
+  guint changes;
+} t_fixture;
+
+static void test_power_write(t_fixture *fixture,
+                             const gchar *supply,
+                             const gchar *attribute,
+                             const gchar *value)
+{
+  gchar *path = g_build_filename(fixture->dir, supply, NULL);
+  gchar *file;
+  gchar *contents;
+
+  g_mkdir_with_parents(path, 0700);
+  file = g_build_filename(path, attribute, NULL);
+  contents = g_strconcat(value, "\n", NULL);
+  g_assert_true(g_file_set_contents(file, contents, -1, NULL));
+
+  g_free(contents);
+  g_free(file);
+  g_free(path);
+}
+
+static void test_power_remove(t_fixture *fixture,
+                              const gchar *supply,
+                              const gchar *attribute)
+{
+  gchar *file = g_build_filename(fixture->dir, supply, attribute, NULL);
+
+  g_remove(file);
+  g_free(file);
+}
+
+static void test_power_changed(t_fixture *fixture)
+{
+  fixture->changes++;
+}
+
+static gboolean test_power_timeout(gboolean *timed_out)
+{
+  *timed_out = TRUE;
+
+  return G_SOURCE_REMOVE;
+}
+
+/* iterate the main loop until the monitor reported a change */
+static void test_power_wait(t_fixture *fixture)
+{
+  guint changes = fixture->changes;
+  gboolean timed_out = FALSE;
+  guint timeout_id;
+
+  timeout_id = g_timeout_add_seconds(5, (GSourceFunc) test_power_timeout, &timed_out);
+  while (fixture->changes == changes && !timed_out)
+    g_main_context_iteration(NULL, TRUE);
+  if (!timed_out)
+    g_source_remove(timeout_id);
+
+  g_assert_false(timed_out);
+}
+
+static void test_power_setup(t_fixture *fixture, gconstpointer data)
+{
+  fixture->dir = g_dir_make_tmp("datetime-power-XXXXXX", NULL);
+  g_assert_nonnull(fixture->dir);
+
+  /* a laptop on battery, with the charger unplugged */
+  test_power_write(fixture, "AC", "type", "Mains");
+  test_power_write(fixture, "AC", "online", "0");
+  test_power_write(fixture, "BAT0", "type", "Battery");
+  test_power_write(fixture, "BAT0", "status", "Discharging");
+  test_power_write(fixture, "BAT0", "capacity", "42");
+
+  g_setenv("DATETIME_POWER_SUPPLY_DIR", fixture->dir, TRUE);
+  fixture->monitor = datetime_power_monitor_new(
+      (t_power_changed_func) test_power_changed, fixture);
+}
+
+static void test_power_teardown(t_fixture *fixture, gconstpointer data)
+{
+  const gchar *supplies[] = { "AC", "BAT0", "BAT1" };
+  const gchar *attributes[] = { "type", "online", "status", "capacity" };
+  gchar *path;
+  guint i, j;
+
+  datetime_power_monitor_free(fixture->monitor);
+
+  for (i = 0; i < G_N_ELEMENTS(supplies); i++)
+  {
+    for (j = 0; j < G_N_ELEMENTS(attributes); j++)
+      test_power_remove(fixture, supplies[i], attributes[j]);
+    path = g_build_filename(fixture->dir, supplies[i], NULL);
+    g_rmdir(path);
+    g_free(path);
+  }
+  g_rmdir(fixture->dir);
+  g_free(fixture->dir);
+}
+
+static void test_power_parse(t_fixture *fixture, gconstpointer data)
+{
+  gint capacity;
+
+  g_assert_true(datetime_power_monitor_discharging(fixture->monitor, &capacity));
+  g_assert_cmpint(capacity, ==, 42);
+}
+
+static void test_power_threshold(t_fixture *fixture, gconstpointer data)
+{
+  /* throttled at or below the threshold, and never with a threshold of 0 */
+  g_assert_true(datetime_power_monitor_throttles(fixture->monitor, 100));
+  g_assert_true(datetime_power_monitor_throttles(fixture->monitor, 42));
+  g_assert_false(datetime_power_monitor_throttles(fixture->monitor, 41));
+  g_assert_false(datetime_power_monitor_throttles(fixture->monitor, 0));
+}
+
+static void test_power_lowest(t_fixture *fixture, gconstpointer data)
+{
+  gint capacity;
+
+  /* the emptiest discharging battery counts */
+  test_power_write(fixture, "BAT1", "type", "Battery");
+  test_power_write(fixture, "BAT1", "status", "Discharging");
+  test_power_write(fixture, "BAT1", "capacity", "17");
+  datetime_power_monitor_free(fixture->monitor);
+  fixture->monitor = datetime_power_monitor_new(
+      (t_power_changed_func) test_power_changed, fixture);
+
+  g_assert_true(datetime_power_monitor_discharging(fixture->monitor, &capacity));
+  g_assert_cmpint(capacity, ==, 17);
+  g_assert_false(datetime_power_monitor_throttles(fixture->monitor, 16));
+}
+
+static void test_power_unknown_capacity(t_fixture *fixture, gconstpointer data)
+{
+  gint capacity;
+
+  test_power_remove(fixture, "BAT0", "capacity");
+  test_power_wait(fixture);
+
+  g_assert_true(datetime_power_monitor_discharging(fixture->monitor, &capacity));
+  g_assert_cmpint(capacity, ==, -1);
+  g_assert_true(datetime_power_monitor_throttles(fixture->monitor, 1));
+}
+
+static void test_power_charging(t_fixture *fixture, gconstpointer data)
+{
+  gint capacity;
+
+  test_power_write(fixture, "BAT0", "status", "Charging");
+  test_power_wait(fixture);
+
+  g_assert_false(datetime_power_monitor_discharging(fixture->monitor, &capacity));
+  g_assert_false(datetime_power_monitor_throttles(fixture->monitor, 100));
+
+  test_power_write(fixture, "BAT0", "status", "Discharging");
+  test_power_wait(fixture);
+
+  g_assert_true(datetime_power_monitor_throttles(fixture->monitor, 100));
+}
+
+int main(int argc, char **argv)
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add("/power/parse", t_fixture, NULL,
+             test_power_setup, test_power_parse, test_power_teardown);
+  g_test_add("/power/threshold", t_fixture, NULL,
+             test_power_setup, test_power_threshold, test_power_teardown);
+  g_test_add("/power/lowest", t_fixture, NULL,
+             test_power_setup, test_power_lowest, test_power_teardown);
+  g_test_add("/power/unknown-capacity", t_fixture, NULL,
+             test_power_setup, test_power_unknown_capacity, test_power_teardown);
+  g_test_add("/power/charging", t_fixture, NULL,
+             test_power_setup, test_power_charging, test_power_teardown);
+
+  return g_test_run();
+}
@@ -0,0 +1,270 @@
+/*  $Id$
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Library General Public License as published
+ *  by the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* for RTLD_NEXT */
+#define _GNU_SOURCE
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+
+/*
+ * The steady state of the clock does not allocate in the plugin's own code:
+ * malloc(), calloc() and realloc() are interposed and counted while the
+ * plugin runs 10,000 updates through datetime_update(), i.e. breaking the
+ * time down, taking the strings the worker prepared for it, setting them
+ * with their markup and measuring the latency. The wall clock the plugin
+ * sees is simulated, one second per update.
+ * GTK allocates to lay the labels out, which is not counted.
+ */
+
+/* local includes */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <glib/gstdio.h>
+
+/* xfce includes */
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4panel/libxfce4panel.h>
+
+#include "panel-plugin/datetime.h"
+
+#define TEST_TICKS 10000
+
+/* updates run before counting, which may fill caches */
+#define TEST_WARMUP 100
+
+/*
+ * Milliseconds into the second the updates run at, so that the worker is
+ * asked to prepare the next second right away, a little more than the
+ * 100 ms ahead the plugin prepares strings.
+ */
+#define TEST_LATE 898
+
+/*
+ * Seconds with markup, the date from a string table in a locale whose
+ * strings are converted to UTF-8, usually
+ */
+#define TEST_RC \
+  "layout=0\n" \
+  "date_format=%A %d %B %Y\n" \
+  "time_format=<b>%H:%M</b>:%S\n" \
+  "date_locale=POSIX\n" \
+  "timezone=UTC\n" \
+  "string_tables=true\n"
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static gint counting;
+static gint allocations;
+
+/* calls into GTK on this thread, whose allocations are not counted */
+static __thread gint in_gtk;
+
+/* the wall clock in microseconds, or 0 for the real one */
+static gint64 test_now;
+
+static inline void test_count(void)
+{
+  if (g_atomic_int_get(&counting) && in_gtk == 0)
+    g_atomic_int_inc(&allocations);
+}
+
+void *malloc(size_t size)
+{
+  test_count();
+
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+  test_count();
+
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+  test_count();
+
+  return __libc_realloc(ptr, size);
+}
+
+gint64 g_get_real_time(void)
+{
+  struct timespec ts;
+
+  if (test_now != 0)
+    return test_now;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+void gtk_label_set_text(GtkLabel *label, const gchar *str)
+{
+  static void (*real)(GtkLabel *, const gchar *) = NULL;
+
+  if (real == NULL)
+    real = (void (*)(GtkLabel *, const gchar *)) dlsym(RTLD_NEXT, "gtk_label_set_text");
+
+  in_gtk++;
+  real(label, str);
+  in_gtk--;
+}
+
+void gtk_label_set_attributes(GtkLabel *label, PangoAttrList *attrs)
+{
+  static void (*real)(GtkLabel *, PangoAttrList *) = NULL;
+
+  if (real == NULL)
+    real = (void (*)(GtkLabel *, PangoAttrList *)) dlsym(RTLD_NEXT, "gtk_label_set_attributes");
+
+  in_gtk++;
+  real(label, attrs);
+  in_gtk--;
+}
+
+/* run the main loop until everything queued, e.g. drawing, is done */
+static void test_flush(void)
+{
+  while (gtk_events_pending())
+    gtk_main_iteration_do(FALSE);
+}
+
+/* one update late in the second, which shows the strings the worker prepared */
+static void test_tick(t_datetime *datetime, gint64 stamp)
+{
+  gchar expected[16];
+  time_t seconds = stamp;
+  struct tm tm;
+
+  test_now = stamp * G_USEC_PER_SEC + TEST_LATE * 1000;
+  datetime_update(datetime);
+
+  /* wait for the worker to render the next second */
+  while (g_atomic_pointer_get(&datetime->render_request) != NULL)
+    g_usleep(100);
+  g_usleep(100);
+
+  in_gtk++;
+  gmtime_r(&seconds, &tm);
+  strftime(expected, sizeof(expected), "%H:%M:%S", &tm);
+  g_assert_cmpstr(gtk_label_get_text(GTK_LABEL(datetime->time_label)), ==, expected);
+  g_assert_cmpstr(gtk_label_get_text(GTK_LABEL(datetime->date_label)), !=, "");
+  in_gtk--;
+}
+
+static void test_tick_alloc(void)
+{
+  XfcePanelPlugin *plugin;
+  t_datetime *datetime;
+  GtkWidget *panel;
+  gchar *stats_file;
+  gint64 stamp = 1700000000;
+  gint fd;
+  guint i;
+
+  /* the report of the latency is written, too */
+  fd = g_file_open_tmp("datetime-latency-XXXXXX", &stats_file, NULL);
+  g_assert_cmpint(fd, >=, 0);
+  close(fd);
+  g_setenv("DATETIME_LATENCY_STATS", stats_file, TRUE);
+
+  plugin = g_object_new(XFCE_TYPE_PANEL_PLUGIN,
+                        "name", "datetime",
+                        "unique-id", 1,
+                        "display-name", "DateTime",
+                        "comment", "Date and time",
+                        "arguments", NULL,
+                        NULL);
+  datetime = datetime_new(plugin);
+  gtk_container_add(GTK_CONTAINER(plugin), datetime->button);
+  panel = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+  gtk_container_add(GTK_CONTAINER(panel), GTK_WIDGET(plugin));
+  gtk_widget_show_all(panel);
+  test_flush();
+
+  for (i = 0; i < TEST_WARMUP; i++)
+    test_tick(datetime, stamp++);
+
+  g_atomic_int_set(&counting, TRUE);
+  for (i = 0; i < TEST_TICKS; i++)
+    test_tick(datetime, stamp++);
+  g_atomic_int_set(&counting, FALSE);
+
+  g_assert_cmpint(g_atomic_int_get(&allocations), ==, 0);
+
+  test_now = 0;
+  datetime_free(plugin, datetime);
+  gtk_widget_destroy(panel);
+  g_remove(stats_file);
+  g_free(stats_file);
+}
+
+/* the plugin reads its settings from a scratch configuration directory */
+static gchar * test_prepare_config(void)
+{
+  gchar *dir = g_dir_make_tmp("datetime-tick-XXXXXX", NULL);
+  gchar *panel_dir, *rc, *cache_dir;
+
+  g_assert_nonnull(dir);
+
+  panel_dir = g_build_filename(dir, "xfce4", "panel", NULL);
+  g_mkdir_with_parents(panel_dir, 0700);
+  rc = g_build_filename(panel_dir, "datetime-1.rc", NULL);
+  g_assert_true(g_file_set_contents(rc, TEST_RC, -1, NULL));
+  cache_dir = g_build_filename(dir, "cache", NULL);
+  g_setenv("XDG_CONFIG_HOME", dir, TRUE);
+  g_setenv("XDG_CACHE_HOME", cache_dir, TRUE);
+
+  g_free(cache_dir);
+  g_free(rc);
+  g_free(panel_dir);
+
+  return dir;
+}
+
+int main(int argc, char **argv)
+{
+  gchar *dir;
+  gint ret;
+
+  dir = test_prepare_config();
+
+  g_test_init(&argc, &argv, NULL);
+
+  /* the plugin's widgets need a display, e.g. from xvfb-run */
+  if (!gtk_init_check(&argc, &argv))
+    return 77;
+
+  g_test_add_func("/tick/alloc", test_tick_alloc);
+
+  ret = g_test_run();
+
+  g_free(dir);
+
+  return ret;
+}